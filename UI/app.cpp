@@ -1,4 +1,5 @@
 #include "../computer.hpp"
+#include "../pacer.hpp"
 #include <gtkmm.h>
 #include <iostream>
 
@@ -14,6 +15,8 @@ public:
 
 private:
     IBM650::Computer c;
+    /// Runs started programs at the real machine's speed.
+    IBM650::Pacer m_pacer;
 
     void on_power_on();
     void on_power_off();
@@ -68,9 +71,12 @@ private:
 
     double m_time_s = 0.0;
     double m_last_step_s = 0.0;
+    // True while a started program is paced from update().
+    bool m_running = false;
 };
 
 Console::Console(Glib::RefPtr<Gtk::Builder> builder)
+    : m_pacer(c)
 {
     auto add_button = [builder, this](std::string id, void(Console::*callback)()) {
         Gtk::Button* b;
@@ -277,11 +283,16 @@ void Console::on_transfer()
 }
 void Console::on_program_start()
 {
-    c.program_start();
+    // Run in paced slices so the console stays responsive.
+    m_pacer.start();
+    m_running = m_pacer.catch_up() == IBM650::Computer::Run_Status::time_limit;
+    display();
 }
 void Console::on_program_stop()
 {
-    //!!TODO c.program_stop();
+    // The program only runs in update() on this thread, so there's no run in progress to
+    // interrupt.  Stop scheduling slices.
+    m_running = false;
 }
 void Console::on_program_reset()
 {
@@ -348,6 +359,8 @@ bool Console::update(int timer)
         c.step(seconds);
         m_last_step_s += seconds;
     }
+    if (m_running)
+        m_running = m_pacer.catch_up() == IBM650::Computer::Run_Status::time_limit;
     display();
     return true;
 }
@@ -0,0 +1,120 @@
+#include "../job.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Memory and cache use of many resident machines.  Starts n copies of a small counting loop
+// and runs them an instruction at a time, round-robin, so each instruction works on a
+// different machine like a busy job server does.
+//
+//   IBM650_benchmark [machines] [instructions per machine]
+
+static constexpr std::size_t default_machines = 10'000;
+static constexpr std::size_t default_instructions = 100;
+
+/// @Return the resident set size of this process in bytes.
+static std::size_t resident_bytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages = 0;
+    std::size_t resident = 0;
+    statm >> pages >> resident;
+    return resident*sysconf(_SC_PAGESIZE);
+}
+
+/// A hardware counter for last-level cache misses of this thread.  Not available on all
+/// systems.
+class Cache_Miss_Counter
+{
+public:
+    Cache_Miss_Counter() {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~Cache_Miss_Counter() {
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+    bool is_available() const { return m_fd >= 0; }
+    void start() {
+        if (!is_available())
+            return;
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    long long stop() {
+        if (!is_available())
+            return 0;
+        ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
+
+private:
+    int m_fd;
+};
+
+/// Add 1 to lower and store it in 0100 forever.
+static IBM650::Job counter_job()
+{
+    using namespace IBM650;
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,5, '+'});
+    job.drum = {{Address({0,0,0,5}), Word({1,5, 1,0,0,0, 0,0,0,6, '+'})},
+                {Address({0,0,0,6}), Word({2,0, 0,1,0,0, 0,0,0,5, '+'})},
+                {Address({1,0,0,0}), Word({0,0, 0,0,0,0, 0,0,0,1, '+'})}};
+    return job;
+}
+
+int main(int argc, char** argv)
+{
+    auto n_machines = argc > 1 ? std::stoul(argv[1]) : default_machines;
+    auto n_instructions = argc > 2 ? std::stoul(argv[2]) : default_instructions;
+
+    IBM650::Computer_Pool pool;
+    auto prototype = pool.acquire();
+    auto unit = std::make_shared<IBM533::Input_Output_Unit>();
+    IBM650::start_job(prototype, unit, counter_job());
+
+    auto before = resident_bytes();
+    std::vector<IBM650::Computer> machines(n_machines, *prototype);
+    auto after = resident_bytes();
+
+    Cache_Miss_Counter counter;
+    IBM650::Job_Result::Status status;
+    auto start = std::chrono::steady_clock::now();
+    counter.start();
+    for (std::size_t i = 0; i < n_instructions; ++i)
+        for (auto& machine : machines)
+            IBM650::step_job(machine, status);
+    auto misses = counter.stop();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    double total = double(n_machines)*n_instructions;
+
+    std::cout << "machines:                   " << n_machines << '\n'
+              << "sizeof(Computer):           " << sizeof(IBM650::Computer) << " bytes\n"
+              << "resident bytes per machine: " << (after - before)/n_machines << '\n'
+              << "ns per instruction:         " << seconds.count()*1e9/total << '\n'
+              << "cache misses per instruction: ";
+    if (counter.is_available())
+        std::cout << misses/total << '\n';
+    else
+        std::cout << "not available\n";
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "../input_output_unit.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Throughput of the card unit's feeds.  Streams cards through the read feed into a spilling
+// stacker, and punches cards from a loaded hopper into a spilling stacker.  Heap allocations
+// are counted so that any per-card allocation shows up.  Then times card-to-buffer and
+// buffer-to-card conversion on their own.
+//
+//   IBM650_card_benchmark [cards]
+
+using namespace IBM533;
+
+static constexpr std::size_t default_cards = 1'000'000;
+
+static std::size_t n_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++n_allocations;
+    if (auto p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+/// A client that advances the unit as soon as it's resumed, like a tight read or punch loop.
+class Client : public Source_Client, public Sink_Client
+{
+public:
+    virtual void connect_source(std::weak_ptr<Source>) override {}
+    virtual void connect_sink(std::weak_ptr<Sink>) override {}
+    virtual void resume_source_client() override { m_source_resumed = true; }
+    virtual void resume_sink_client() override { m_sink_resumed = true; }
+    /// @Return true and clear the flag if the client was resumed.
+    bool take_source() { return std::exchange(m_source_resumed, false); }
+    bool take_sink() { return std::exchange(m_sink_resumed, false); }
+
+private:
+    bool m_source_resumed = false;
+    bool m_sink_resumed = false;
+};
+
+static Card test_card(std::size_t n)
+{
+    Card card;
+    for (std::size_t i = 0; i < card_columns; ++i)
+        card[i] = 1 << (n + i) % 10;
+    return card;
+}
+
+static void report(const char* name, std::size_t n_cards, std::size_t allocations,
+                   std::chrono::steady_clock::duration time)
+{
+    std::chrono::duration<double> seconds = time;
+    std::cout << name << " cards per second:  " << n_cards/seconds.count() << '\n'
+              << name << " allocations per card: " << double(allocations)/n_cards << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    auto n_cards = argc > 1 ? std::stoul(argv[1]) : default_cards;
+    auto client = std::make_shared<Client>();
+    std::size_t n_written = 0;
+    auto count = [&n_written](const Card&) { ++n_written; };
+
+    {
+        Input_Output_Unit unit;
+        unit.connect_source_client(client);
+        std::size_t n_pulled = 0;
+        auto card = test_card(0);
+        unit.load_read_hopper([&](Card& c) { c = card; return n_pulled++ < n_cards; });
+        unit.spill_read_stacker(count);
+        unit.read_start();
+
+        auto start = std::chrono::steady_clock::now();
+        auto allocations = n_allocations;
+        while (client->take_source())
+            unit.advance_source();
+        report("read  ", n_written, n_allocations - allocations,
+               std::chrono::steady_clock::now() - start);
+    }
+
+    {
+        Input_Output_Unit unit;
+        unit.connect_sink_client(client);
+        unit.load_punch_hopper(Card_Deck(n_cards, Card{}));
+        unit.spill_punch_stacker(count);
+        unit.punch_start();
+
+        n_written = 0;
+        auto buffer = card_to_buffer(test_card(1));
+        auto start = std::chrono::steady_clock::now();
+        auto allocations = n_allocations;
+        while (client->take_sink())
+        {
+            unit.get_sink() = buffer;
+            unit.advance_sink();
+        }
+        report("punch ", n_written, n_allocations - allocations,
+               std::chrono::steady_clock::now() - start);
+    }
+    {
+        // Conversion alone, without the feeds.
+        std::vector<Packed_Card> cards;
+        for (std::size_t n = 0; n < 1000; ++n)
+            cards.emplace_back(test_card(n));
+        Buffer buffer;
+        Card_Check check;
+        std::size_t n_valid = 0;
+        card_to_buffer(cards[0], buffer);
+        auto start = std::chrono::steady_clock::now();
+        auto allocations = n_allocations;
+        for (std::size_t n = 0; n < n_cards; ++n)
+            n_valid += card_to_buffer(cards[n % cards.size()], buffer, check);
+        report("decode", n_valid, n_allocations - allocations, std::chrono::steady_clock::now() - start);
+
+        start = std::chrono::steady_clock::now();
+        allocations = n_allocations;
+        for (std::size_t n = 0; n < n_cards; ++n)
+            cards[n % cards.size()] = buffer_to_packed_card(buffer);
+        report("encode", n_cards, n_allocations - allocations, std::chrono::steady_clock::now() - start);
+    }
+    return 0;
+}
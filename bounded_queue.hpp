@@ -0,0 +1,78 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/// A queue with a maximum size for passing items between threads.  Pushing waits while the
+/// queue is full, so a fast producer is held back to the speed of its consumer.
+template <typename T> class Bounded_Queue
+{
+public:
+    Bounded_Queue(std::size_t capacity);
+
+    /// Wait for room and add an item to the back.  @Return false if the queue was closed.
+    bool push(T item);
+    /// Wait for an item and remove it from the front.  @Return false if the queue was closed
+    /// and is empty.
+    bool pop(T& item);
+    /// Stop accepting items.  Items already queued may still be popped.
+    void close();
+
+private:
+    std::size_t m_capacity;
+    std::deque<T> m_items;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+};
+
+template <typename T>
+Bounded_Queue<T>::Bounded_Queue(std::size_t capacity)
+    : m_capacity(capacity)
+{}
+
+template <typename T>
+bool Bounded_Queue<T>::push(T item)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed)
+            return false;
+        m_items.push_back(std::move(item));
+    }
+    m_not_empty.notify_one();
+    return true;
+}
+
+template <typename T>
+bool Bounded_Queue<T>::pop(T& item)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+    }
+    m_not_full.notify_one();
+    return true;
+}
+
+template <typename T>
+void Bounded_Queue<T>::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_not_full.notify_all();
+    m_not_empty.notify_all();
+}
+
+#endif
@@ -3,10 +3,116 @@
 
 #include "register.hpp"
 
-#include <deque>
+#include <array>
+#include <cassert>
+#include <cstddef>
 #include <memory>
 
-using Buffer = std::deque<IBM650::Word>;
+/// The words of a card passed between the computer and a card unit.  The words are held in
+/// place, up to a fixed capacity, so filling, passing and clearing a buffer never allocates.
+class Buffer
+{
+public:
+    static constexpr std::size_t capacity = 10;
+
+    using value_type = IBM650::Word;
+    using iterator = IBM650::Word*;
+    using const_iterator = const IBM650::Word*;
+
+    /// Make an empty buffer.
+    Buffer() = default;
+    /// Make a buffer with n blank words.
+    explicit Buffer(std::size_t n) : m_size(n) { assert(n <= capacity); }
+    /// Make a buffer with n copies of a word.
+    Buffer(std::size_t n, const IBM650::Word& word);
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /// Give access to the words as a contiguous span of size() words.
+    IBM650::Word* data() { return m_words.data(); }
+    const IBM650::Word* data() const { return m_words.data(); }
+    iterator begin() { return data(); }
+    iterator end() { return data() + m_size; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + m_size; }
+
+    IBM650::Word& operator[](std::size_t n) { assert(n < m_size); return m_words[n]; }
+    const IBM650::Word& operator[](std::size_t n) const { assert(n < m_size); return m_words[n]; }
+    IBM650::Word& front() { return (*this)[0]; }
+    const IBM650::Word& front() const { return (*this)[0]; }
+    IBM650::Word& back() { return (*this)[m_size - 1]; }
+    const IBM650::Word& back() const { return (*this)[m_size - 1]; }
+
+    void push_back(const IBM650::Word& word);
+    /// Change the number of words.  Added words are blank.
+    void resize(std::size_t n);
+    void clear() { m_size = 0; }
+
+    bool operator==(const Buffer& buffer) const;
+    bool operator!=(const Buffer& buffer) const { return !(*this == buffer); }
+
+private:
+    std::array<IBM650::Word, capacity> m_words;
+    std::size_t m_size = 0;
+};
+
+inline Buffer::Buffer(std::size_t n, const IBM650::Word& word)
+    : m_size(n)
+{
+    assert(n <= capacity);
+    std::fill(begin(), end(), word);
+}
+
+inline void Buffer::push_back(const IBM650::Word& word)
+{
+    assert(m_size < capacity);
+    m_words[m_size++] = word;
+}
+
+inline void Buffer::resize(std::size_t n)
+{
+    assert(n <= capacity);
+    for (auto i = m_size; i < n; ++i)
+        m_words[i] = IBM650::Word();
+    m_size = n;
+}
+
+inline bool Buffer::operator==(const Buffer& buffer) const
+{
+    return std::equal(begin(), end(), buffer.begin(), buffer.end());
+}
+
+/// A pair of buffers for passing cards without copying.  The producer fills the back buffer
+/// while the consumer reads the front one.  Then they're flipped.
+class Double_Buffer
+{
+public:
+    Buffer& front() { return m_buffers[m_front]; }
+    const Buffer& front() const { return m_buffers[m_front]; }
+    Buffer& back() { return m_buffers[1 - m_front]; }
+    const Buffer& back() const { return m_buffers[1 - m_front]; }
+    /// Make the back buffer the front one.
+    void flip() { m_front = 1 - m_front; }
+
+private:
+    std::array<Buffer, 2> m_buffers;
+    std::size_t m_front = 0;
+};
+
+/// Why a source or sink hasn't resumed its client.
+enum class Card_Hold
+{
+    /// The reason isn't known, e.g. because the unit is on another thread.
+    unknown,
+    /// The unit hasn't been started, or was stopped.
+    stopped,
+    /// The hopper ran out of cards.
+    hopper_empty,
+    /// Cards are left in the read feed, but the hopper is empty and the end-of-file key
+    /// hasn't been pressed.
+    end_of_file,
+};
 
 class Source_Client;
 
@@ -15,7 +121,11 @@ class Source
 public:
     virtual void connect_source_client(std::weak_ptr<Source_Client> client) = 0;
     virtual void advance_source() = 0;
-    virtual Buffer& get_source() = 0;
+    /// @Return the words of the card that was read.  Valid from when the client is resumed
+    /// until it calls advance_source().
+    virtual const Buffer& get_source() = 0;
+    /// @Return why the client is waiting to be resumed after advance_source().
+    virtual Card_Hold source_hold() const { return Card_Hold::unknown; }
 };
 
 class Source_Client
@@ -32,7 +142,11 @@ class Sink
 public:
     virtual void connect_sink_client(std::weak_ptr<Sink_Client> client) = 0;
     virtual void advance_sink() = 0;
+    /// @Return the buffer for the client to fill with the words to punch.  It's empty when
+    /// the client is resumed.
     virtual Buffer& get_sink() = 0;
+    /// @Return why the client is waiting to be resumed after advance_sink().
+    virtual Card_Hold sink_hold() const { return Card_Hold::unknown; }
 };
 
 class Sink_Client
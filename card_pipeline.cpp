@@ -0,0 +1,89 @@
+#include "card_pipeline.hpp"
+
+using namespace IBM533;
+
+Card_Pipeline::Card_Pipeline(Card_Reader reader, Card_Writer writer, std::size_t queue_size)
+    : m_reader(reader),
+      m_writer(writer),
+      m_read_queue(queue_size),
+      m_punch_queue(queue_size)
+{
+}
+
+Card_Pipeline::~Card_Pipeline()
+{
+    finish();
+}
+
+void Card_Pipeline::start()
+{
+    m_decode_thread = std::thread(&Card_Pipeline::decode, this);
+    m_encode_thread = std::thread(&Card_Pipeline::encode, this);
+    if (auto client = m_sink_client.lock())
+        client->resume_sink_client();
+    advance_source();
+}
+
+void Card_Pipeline::finish()
+{
+    // Stop reading even if the client didn't use all the cards.
+    m_read_queue.close();
+    if (m_decode_thread.joinable())
+        m_decode_thread.join();
+    m_punch_queue.close();
+    if (m_encode_thread.joinable())
+        m_encode_thread.join();
+}
+
+void Card_Pipeline::decode()
+{
+    Card card;
+    while (m_reader(card))
+        if (!m_read_queue.push(card_to_buffer(card)))
+            return;
+    m_read_queue.close();
+}
+
+void Card_Pipeline::encode()
+{
+    Buffer buffer;
+    while (m_punch_queue.pop(buffer))
+        m_writer(buffer_to_card(buffer));
+}
+
+void Card_Pipeline::connect_source_client(std::weak_ptr<Source_Client> client)
+{
+    m_source_client = client;
+}
+
+void Card_Pipeline::advance_source()
+{
+    // The client stays stopped after the last card, like a reader with an empty hopper.
+    if (!m_read_queue.pop(m_source_buffer))
+        return;
+    if (auto client = m_source_client.lock())
+        client->resume_source_client();
+}
+
+const Buffer& Card_Pipeline::get_source()
+{
+    return m_source_buffer;
+}
+
+void Card_Pipeline::connect_sink_client(std::weak_ptr<Sink_Client> client)
+{
+    m_sink_client = client;
+}
+
+void Card_Pipeline::advance_sink()
+{
+    m_punch_queue.push(std::move(m_sink_buffer));
+    m_sink_buffer.clear();
+    if (auto client = m_sink_client.lock())
+        client->resume_sink_client();
+}
+
+Buffer& Card_Pipeline::get_sink()
+{
+    return m_sink_buffer;
+}
@@ -0,0 +1,74 @@
+#ifndef CARD_PIPELINE_HPP
+#define CARD_PIPELINE_HPP
+
+#include "bounded_queue.hpp"
+#include "input_output_unit.hpp"
+
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace IBM533
+{
+/// A batch runner for card jobs in 3 stages.  One thread reads cards and decodes them to
+/// buffers, the client (the computer) runs on the caller's thread, and another thread
+/// encodes punched buffers to cards and writes them.  The stages are connected by bounded
+/// queues.  A stage that gets ahead waits for the next one.
+///
+/// The client connects to the pipeline like it would to an Input_Output_Unit with endless
+/// hoppers.  Unlike the unit, there are no operator keys: reading continues until the input
+/// runs out, and punching is always ready.
+class Card_Pipeline : public Source, public Sink
+{
+public:
+    /// A function that sets its argument to the next input card.  @Return false when there
+    /// are no more cards.
+    using Card_Reader = IBM533::Card_Reader;
+    /// A function that takes punched cards in order.
+    using Card_Writer = IBM533::Card_Writer;
+
+    /// Make a pipeline that holds up to queue_size buffers between stages.
+    Card_Pipeline(Card_Reader reader, Card_Writer writer, std::size_t queue_size = 64);
+    /// Calls finish() if it hasn't been called.
+    ~Card_Pipeline();
+
+    /// Start the reading and punching threads.  Resume the clients when the first card is
+    /// read.
+    void start();
+    /// Wait for all punched cards to be written and stop the threads.
+    void finish();
+
+    // Source overrides
+
+    virtual void connect_source_client(std::weak_ptr<Source_Client> client) override;
+    /// Wait for the next decoded card, if any, and resume the source client.
+    virtual void advance_source() override;
+    virtual const Buffer& get_source() override;
+
+    // Sink overrides
+
+    virtual void connect_sink_client(std::weak_ptr<Sink_Client> client) override;
+    /// Pass the sink buffer to the punching thread and resume the sink client.  Waits if the
+    /// punching thread has fallen behind.
+    virtual void advance_sink() override;
+    virtual Buffer& get_sink() override;
+
+private:
+    void decode();
+    void encode();
+
+    Card_Reader m_reader;
+    Card_Writer m_writer;
+    Bounded_Queue<Buffer> m_read_queue;
+    Bounded_Queue<Buffer> m_punch_queue;
+    std::thread m_decode_thread;
+    std::thread m_encode_thread;
+
+    std::weak_ptr<Source_Client> m_source_client;
+    std::weak_ptr<Sink_Client> m_sink_client;
+    Buffer m_source_buffer;
+    Buffer m_sink_buffer;
+};
+}
+
+#endif
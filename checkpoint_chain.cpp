@@ -0,0 +1,60 @@
+#include "checkpoint_chain.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace IBM650;
+
+void Checkpoint_Chain::checkpoint(Computer& computer)
+{
+    std::ostringstream os;
+    if (m_base.empty())
+    {
+        computer.save_state(os);
+        computer.forget_changes();
+        m_base = os.str();
+    }
+    else
+    {
+        computer.save_changes(os);
+        m_changes.push_back(os.str());
+    }
+}
+
+void Checkpoint_Chain::restore(Computer& computer) const
+{
+    if (m_base.empty())
+        throw std::runtime_error("no checkpoints");
+    std::istringstream base(m_base);
+    computer.load_state(base);
+    for (const auto& changes : m_changes)
+    {
+        std::istringstream is(changes);
+        computer.load_changes(is);
+    }
+}
+
+void Checkpoint_Chain::compact()
+{
+    if (m_changes.empty())
+        return;
+    Computer computer;
+    restore(computer);
+    std::ostringstream os;
+    computer.save_state(os);
+    m_base = os.str();
+    m_changes.clear();
+}
+
+std::size_t Checkpoint_Chain::length() const
+{
+    return (m_base.empty() ? 0 : 1) + m_changes.size();
+}
+
+std::size_t Checkpoint_Chain::size() const
+{
+    auto n = m_base.size();
+    for (const auto& changes : m_changes)
+        n += changes.size();
+    return n;
+}
@@ -0,0 +1,37 @@
+#ifndef CHECKPOINT_CHAIN_HPP
+#define CHECKPOINT_CHAIN_HPP
+
+#include "computer.hpp"
+
+#include <string>
+#include <vector>
+
+namespace IBM650
+{
+/// A full snapshot of a computer followed by incremental snapshots of the changes after it.
+/// Checkpoints of a long job cost about as much as the words it changed since the last one.
+class Checkpoint_Chain
+{
+public:
+    /// Add a checkpoint of the computer.  The first one is a full snapshot.  The rest hold
+    /// the drum words changed since the one before.  All checkpoints must be of the same
+    /// computer, and nothing else may save its changes while the chain is in use.
+    void checkpoint(Computer& computer);
+    /// Restore the computer to the latest checkpoint.  Throws std::runtime_error if the chain
+    /// is empty.
+    void restore(Computer& computer) const;
+    /// Replace the chain with a full snapshot of its latest checkpoint.
+    void compact();
+
+    /// @Return the number of snapshots in the chain.
+    std::size_t length() const;
+    /// @Return the number of bytes in the chain's snapshots.
+    std::size_t size() const;
+
+private:
+    std::string m_base;
+    std::vector<std::string> m_changes;
+};
+}
+
+#endif
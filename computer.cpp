@@ -1,8 +1,15 @@
 #include "computer.hpp"
+#include "mapped_file.hpp"
+#include "snapshot.hpp"
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/log/expressions.hpp>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
 
 #define LOG BOOST_LOG_TRIVIAL
 
@@ -11,9 +18,18 @@ using namespace IBM650;
 namespace IBM650
 {
 /// DC power comes on 3 minutes after main power.
-const TTime dc_on_delay_seconds = 180;
+const TClock dc_on_delay = 180*microseconds_per_second;
 /// The blower stays on 5 minutes after main power is turned off.
-const TTime blower_off_delay_seconds = 300;
+const TClock blower_off_delay = 300*microseconds_per_second;
+/// The 533 reads 200 cards per minute and punches 100.  A read or punch instruction starts a
+/// card cycle, and the next one waits for it to end.
+const TClock read_cycle_time = 300*microseconds_per_second/1000;
+const TClock punch_cycle_time = 600*microseconds_per_second/1000;
+/// The read band is words 01-10 of the data address's band and the punch band is words
+/// 27-36.  E.g. reading with data address 1977 stores words 1951-1960.
+const std::size_t read_band_start = 1;
+const std::size_t punch_band_start = 27;
+const std::size_t card_band_size = 10;
 
 const Address storage_entry_address({8,0,0,0});
 const Address distributor_address({8,0,0,1});
@@ -63,6 +79,9 @@ enum class Operation
 
     load_distributor = 69,
 
+    read = 70,
+    punch = 71,
+
     table_lookup = 84,
 
     branch_on_8_in_distributor_position_10 = 90
@@ -78,6 +97,154 @@ std::size_t index_of_address(const Address& addr)
     return addr.value() % band_size;
 }
 
+// Snapshots store bools and switch positions in a byte, counters in 8 bytes, and registers
+// as their bi-quinary codes, a byte per digit.  Pending power events are saved with the
+// scheduler's clock, and so are card cycles in progress.  Connections to the card unit are
+// not saved.
+const char snapshot_format[] = "I650";
+// Incremental snapshots have the same machine state but only the changed drum words, each
+// with its word number, band*50 + index.
+const char changes_format[] = "I65C";
+const std::uint16_t snapshot_version = 5;
+
+// Drum files start with a format tag and version, padded to 8 bytes.  The packed words
+// follow in address order.
+const char drum_file_format[] = {'D', 'R', 'U', 'M'};
+const std::uint16_t drum_file_version = 2;
+const std::size_t drum_file_header_size = 8;
+
+// State hashes are the XOR of a hash for each word and register.  The hash of a part of the
+// state is its codes mixed with a key for the part, like the random numbers for each
+// position in a Zobrist hash.  Drum words have their word number as their key.
+
+/// @Return a well-mixed 64-bit number for x.  The finalizer from SplitMix64.
+std::uint64_t mix(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27))*0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+/// @Return the hash of n codes for the part of the state with the passed-in key.  Blank
+/// words and registers hash to 0, so a blank drum's hash is 0.
+std::uint64_t hash_codes(std::uint64_t key, const TDigit* codes, std::size_t n)
+{
+    if (std::all_of(codes, codes + n, [](TDigit code) { return code == 0; }))
+        return 0;
+    auto h = mix(key);
+    for (std::size_t i = 0; i < n; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t chunk = 0;
+        std::memcpy(&chunk, codes + i, std::min(sizeof(chunk), n - i));
+        h = mix(h ^ chunk);
+    }
+    return h;
+}
+
+template <std::size_t N>
+std::uint64_t hash_register(std::uint64_t key, const Register<N>& reg)
+{
+    return hash_codes(key, reg.digits().data(), N);
+}
+
+// Drum words are packed into 6 bytes, least significant byte first.  Each digit and the sign
+// is 4 bits, most significant digit in the low bits.  0 is blank, 1-10 are the codes for
+// 0-9, and 11 is any code that isn't a digit.  The bits of codes that aren't digits are not
+// kept; all of them act the same.
+constexpr std::size_t packed_codes = word_size + 1;
+constexpr std::uint8_t invalid_nibble = 11;
+
+std::uint8_t nibble_of_code(TDigit code)
+{
+    static const auto table = [] {
+        std::array<std::uint8_t, 256> t;
+        t.fill(invalid_nibble);
+        t[0] = 0;
+        for (std::size_t d = 0; d < base; ++d)
+            t[static_cast<unsigned char>(bi_quinary_code[d])] = d + 1;
+        return t;
+    }();
+    return table[static_cast<unsigned char>(code)];
+}
+
+std::uint64_t pack_word(const TDigit* codes)
+{
+    std::uint64_t packed = 0;
+    for (std::size_t i = 0; i < packed_codes; ++i)
+        packed |= std::uint64_t(nibble_of_code(codes[i])) << 4*i;
+    return packed;
+}
+
+void unpack_word(std::uint64_t packed, TDigit* codes)
+{
+    static const auto table = [] {
+        std::array<TDigit, 16> t;
+        t.fill(bin(base));
+        t[0] = 0;
+        for (std::size_t d = 0; d < base; ++d)
+            t[d + 1] = bi_quinary_code[d];
+        return t;
+    }();
+    for (std::size_t i = 0; i < packed_codes; ++i)
+        codes[i] = table[packed >> 4*i & 0xf];
+}
+
+std::uint64_t load_packed(const std::uint8_t* bytes)
+{
+    std::uint64_t packed = 0;
+    for (std::size_t i = 0; i < 6; ++i)
+        packed |= std::uint64_t(bytes[i]) << 8*i;
+    return packed;
+}
+
+void store_packed(std::uint8_t* bytes, std::uint64_t packed)
+{
+    for (std::size_t i = 0; i < 6; ++i)
+        bytes[i] = packed >> 8*i;
+}
+
+/// @Return the hash of a packed drum word.  Blank words hash to 0.
+std::uint64_t hash_packed(std::uint64_t word_number, std::uint64_t packed)
+{
+    return packed == 0 ? 0 : mix(mix(word_number) ^ packed);
+}
+
+template <typename T>
+void put_small(Snapshot::Writer& snapshot, T value)
+{
+    snapshot.put(static_cast<std::uint8_t>(value));
+}
+
+template <typename T>
+void get_small(Snapshot::Reader& snapshot, T& value)
+{
+    value = static_cast<T>(snapshot.get<std::uint8_t>());
+}
+
+void put_count(Snapshot::Writer& snapshot, std::int64_t value)
+{
+    snapshot.put(value);
+}
+
+void get_count(Snapshot::Reader& snapshot, std::int64_t& value)
+{
+    value = snapshot.get<std::int64_t>();
+}
+
+template <std::size_t N>
+void put_register(Snapshot::Writer& snapshot, const Register<N>& reg)
+{
+    snapshot.put_bytes(reg.digits().data(), N);
+}
+
+template <std::size_t N>
+void get_register(Snapshot::Reader& snapshot, Register<N>& reg)
+{
+    auto codes = snapshot.get_bytes(N);
+    std::copy(codes, codes + N, reg.digits().begin());
+}
+
 class Operation_Step
 {
 public:
@@ -108,6 +275,7 @@ OPERATION_STEP(Instruction_to_Program_Register,
         || index_of_address(c.m_address_register) == c.m_drum.index())
     {
         c.m_program_register.load(c.get_storage(c.m_address_register), 0, 0);
+        c.m_instruction_address = c.m_address_register.value();
         LOG(trace) << "I to PR: PR=" << c.m_program_register;
         return true;
     }
@@ -330,10 +498,12 @@ public:
         // Add the distributor until the loop count gets to 0.
         TDigit carry = 0;
         // Signal overflow if the product overflows its 10 digits and changes the units digit of
-        // the multiplier.
-        TDigit multiplier_units = c.m_upper_accumulator[m_shift_count+1];
+        // the multiplier.  On the last pass, the units digit has been shifted out of upper.
+        bool in_upper = m_shift_count < word_size;
+        TDigit multiplier_units = in_upper ? c.m_upper_accumulator[m_shift_count+1] : 0;
         c.add_to_accumulator(c.m_distributor, false, carry);
-        c.m_overflow = c.m_overflow || c.m_upper_accumulator[m_shift_count+1] != multiplier_units;
+        c.m_overflow = c.m_overflow
+            || (in_upper && c.m_upper_accumulator[m_shift_count+1] != multiplier_units);
         --m_upper_overflow;
         if (m_upper_overflow > 0 || m_shift_count < word_size)
             return false;
@@ -520,6 +690,84 @@ OPERATION_STEP(Insert_Address_in_Lower,
     c.m_lower_accumulator.load(c.m_address_register, 0, 2);
     return true;
 })
+
+/// Copy the read buffer to the read band a word at a time as the words pass under the heads.
+/// Then signal the reader to advance and start the read cycle.
+class Read_Buffer_to_Drum : public Operation_Step
+{
+public:
+    Read_Buffer_to_Drum(Computer& computer, Operation op) : Operation_Step(computer, op) {}
+
+    virtual bool execute() override {
+        auto band = band_of_address(c.m_address_register);
+        if (band >= n_bands)
+        {
+            c.m_storage_selection_error = true;
+            return true;
+        }
+        if (m_n_words == 0 && c.m_drum.index() != read_band_start)
+            return false;
+        // Read the source's buffer in place.  It doesn't change until advance_source().
+        auto word = zero;
+        if (auto source = c.m_source.lock())
+            if (m_n_words < source->get_source().size())
+                word = source->get_source()[m_n_words];
+        c.m_drum.write(band, word);
+        if (++m_n_words < card_band_size)
+            return false;
+
+        LOG(trace) << c.m_run_time << " read: band=" << band;
+        c.finish_card_cycles();
+        c.m_card_events.schedule(read_cycle_time, Computer::Card_Event::read_cycle);
+        c.m_source_resumed = false;
+        if (auto source = c.m_source.lock())
+            source->advance_source();
+        return true;
+    }
+
+private:
+    std::size_t m_n_words = 0;
+};
+
+/// Copy the punch band to the punch buffer a word at a time as the words pass under the
+/// heads.  Then signal the punch to advance and start the punch cycle.
+class Punch_Drum_to_Buffer : public Operation_Step
+{
+public:
+    Punch_Drum_to_Buffer(Computer& computer, Operation op) : Operation_Step(computer, op) {}
+
+    virtual bool execute() override {
+        auto band = band_of_address(c.m_address_register);
+        if (band >= n_bands)
+        {
+            c.m_storage_selection_error = true;
+            return true;
+        }
+        if (m_n_words == 0 && c.m_drum.index() != punch_band_start)
+            return false;
+        // Fill the sink's buffer in place.
+        auto sink = c.m_sink.lock();
+        if (sink)
+        {
+            if (m_n_words == 0)
+                sink->get_sink().clear();
+            sink->get_sink().push_back(c.m_drum.read(band));
+        }
+        if (++m_n_words < card_band_size)
+            return false;
+
+        LOG(trace) << c.m_run_time << " punch: band=" << band;
+        c.finish_card_cycles();
+        c.m_card_events.schedule(punch_cycle_time, Computer::Card_Event::punch_cycle);
+        c.m_sink_resumed = false;
+        if (sink)
+            sink->advance_sink();
+        return true;
+    }
+
+private:
+    std::size_t m_n_words = 0;
+};
 }
 
 using Op_Sequence = std::vector<std::shared_ptr<Operation_Step>>;
@@ -597,6 +845,10 @@ Op_Sequence operation_steps(Computer& computer, Operation op)
         return { std::make_shared<Enable_Shift_Control>(computer, op),
                 std::make_shared<Shift>(computer, op),
                 std::make_shared<Remove_Interlock_A>(computer, op) };
+    case Operation::read:
+        return { std::make_shared<Read_Buffer_to_Drum>(computer, op) };
+    case Operation::punch:
+        return { std::make_shared<Punch_Drum_to_Buffer>(computer, op) };
     case Operation::table_lookup:
         return { std::make_shared<Enable_Position_Set>(computer, op),
                 std::make_shared<Look_Up_Address>(computer, op),
@@ -615,7 +867,15 @@ Op_Sequence operation_steps(Computer& computer, Operation op)
 
 /// The initial state is: powered off for long enough that the blower is off.
 Computer::Computer()
-    : m_elapsed_seconds(blower_off_delay_seconds),
+    : m_half_cycle(Half_Cycle::instruction),
+      m_run_time(0),
+      m_restart(false),
+      m_overflow(false),
+      m_storage_selection_error(false),
+      m_clocking_error(false),
+      m_error_sense(false),
+      m_error_stop(false),
+      m_blower_on(false),
       m_can_turn_on(true),
       m_power_on(false),
       m_dc_on(false),
@@ -624,15 +884,7 @@ Computer::Computer()
       m_cycle_mode(Half_Cycle_Mode::run), //!TODO make persistent
       m_display_mode(Display_Mode::distributor),
       m_overflow_mode(Overflow_Mode::stop),
-      m_error_mode(Error_Mode::stop),
-      m_half_cycle(Half_Cycle::instruction),
-      m_run_time(0),
-      m_restart(false),
-      m_overflow(false),
-      m_storage_selection_error(false),
-      m_clocking_error(false),
-      m_error_sense(false),
-      m_error_stop(false)
+      m_error_mode(Error_Mode::stop)
 {
     boost::log::core::get()->set_filter(
         boost::log::trivial::severity >= boost::log::trivial::info);
@@ -643,14 +895,19 @@ void Computer::power_on()
     if (m_power_on || !m_can_turn_on)
         return;
 
-    m_elapsed_seconds = 0;
     m_power_on = true;
+    m_blower_on = true;
+    m_power_events.cancel(Power_Event::blower_off);
+    m_power_events.schedule(dc_on_delay, Power_Event::dc_on);
     assert(!m_dc_on);
 }
 
 void Computer::power_off()
 {
-    m_elapsed_seconds = 0;
+    // The blower stays on for a while after normal power off.
+    if (m_power_on)
+        m_power_events.schedule(blower_off_delay, Power_Event::blower_off);
+    m_power_events.cancel(Power_Event::dc_on);
     m_power_on = false;
     m_dc_on = false;
 }
@@ -659,7 +916,7 @@ void Computer::dc_on()
 {
     // DC power can be turned on manually only after it's been turned on automatically and then
     // turned off manually.
-    bool can_turn_on = m_power_on && m_elapsed_seconds >= dc_on_delay_seconds;
+    bool can_turn_on = m_power_on && !m_power_events.is_pending(Power_Event::dc_on);
     // We're either in a state where DC can be turned on, or it's currently off.
     assert(can_turn_on || !m_dc_on);
     if (can_turn_on)
@@ -675,20 +932,32 @@ void Computer::dc_off()
 void Computer::master_power_off()
 {
     power_off();
+    // Turning off master power turns off the blower immediately.
+    m_power_events.clear();
+    m_blower_on = false;
     m_can_turn_on = false;
 }
 
 void Computer::step(TTime seconds)
 {
-    // Turn DC on if power has been on long enough.
-    if (m_power_on
-        && m_elapsed_seconds < dc_on_delay_seconds
-        && m_elapsed_seconds + seconds >= dc_on_delay_seconds)
+    auto end_time = m_power_events.now() + seconds*microseconds_per_second;
+    Power_Event event;
+    while (m_power_events.pop(end_time, event))
+        handle(event);
+}
+
+void Computer::handle(Power_Event event)
+{
+    switch (event)
     {
-        assert(!m_dc_on);
+    case Power_Event::dc_on:
+        assert(m_power_on && !m_dc_on);
         m_dc_on = true;
+        break;
+    case Power_Event::blower_off:
+        m_blower_on = false;
+        break;
     }
-    m_elapsed_seconds += seconds;
 }
 
 bool Computer::is_on() const
@@ -698,9 +967,7 @@ bool Computer::is_on() const
 
 bool Computer::is_blower_on() const
 {
-    // Turning off master power turns off the blower immediately.  After normal power off, the
-    // blower stays on for a while.
-    return m_can_turn_on && (m_power_on || m_elapsed_seconds < blower_off_delay_seconds);
+    return m_blower_on;
 }
 
 bool Computer::is_ready() const
@@ -768,34 +1035,189 @@ void Computer::transfer()
 void Computer::program_start()
 {
     LOG(trace) << "program start";
+    if (m_control_mode == Control_Mode::manual)
+        manual_operation();
+    else
+        run(std::numeric_limits<TTime>::max(), nullptr);
+}
+
+void Computer::program_stop()
+{
+    m_stop_request.requested = true;
+}
+
+Computer::Run_Status Computer::run_for(TTime word_times)
+{
     if (m_control_mode == Control_Mode::manual)
     {
-        m_distributor = m_storage_entry;
+        manual_operation();
+        return Run_Status::manual;
+    }
+    // Don't overflow the end time for long runs.
+    auto end_time = word_times > std::numeric_limits<TTime>::max() - m_run_time
+        ? std::numeric_limits<TTime>::max()
+        : m_run_time + word_times;
+    return run(end_time, nullptr);
+}
 
-        // It's odd that what happens on program start depends on the display mode, but that
-        // appears to be the case.
-        switch (m_display_mode)
-        {
-        case Display_Mode::read_in_storage:
-            while (m_drum.index() != index_of_address(m_address_entry))
-                m_drum.step();
-            set_storage(m_address_entry, m_distributor);
-            break;
-        case Display_Mode::read_out_storage:
-            while (m_drum.index() != index_of_address(m_address_entry))
-                m_drum.step();
-            m_distributor = get_storage(m_address_entry);
-            break;
-        default:
-            // I don't know what happens if you start in manual mode with other display
-            // settings.  Let's assume it just sets the distributor.
-            break;
-        }
-        return;
+Computer::Run_Status Computer::run_until(const Run_Condition& done)
+{
+    if (m_control_mode == Control_Mode::manual)
+    {
+        manual_operation();
+        return Run_Status::manual;
+    }
+    return run(std::numeric_limits<TTime>::max(), done);
+}
+
+void Computer::manual_operation()
+{
+    m_distributor = m_storage_entry;
+
+    // It's odd that what happens on program start depends on the display mode, but that
+    // appears to be the case.
+    switch (m_display_mode)
+    {
+    case Display_Mode::read_in_storage:
+        while (m_drum.index() != index_of_address(m_address_entry))
+            m_drum.step();
+        set_storage(m_address_entry, m_distributor);
+        break;
+    case Display_Mode::read_out_storage:
+        while (m_drum.index() != index_of_address(m_address_entry))
+            m_drum.step();
+        m_distributor = get_storage(m_address_entry);
+        break;
+    default:
+        // I don't know what happens if you start in manual mode with other display
+        // settings.  Let's assume it just sets the distributor.
+        break;
+    }
+}
+
+bool Computer::should_pause(TTime end_time, const Run_Condition& done, Run_Status& status)
+{
+    if (m_stop_request.requested.load(std::memory_order_relaxed)
+        && m_stop_request.requested.exchange(false))
+        status = Run_Status::stop_requested;
+    else if (m_run_time >= end_time)
+        status = Run_Status::time_limit;
+    else if (done && done(*this))
+        status = Run_Status::condition;
+    else
+        return false;
+    return true;
+}
+
+bool Computer::wait_for_card_unit(int operation)
+{
+    Card_Event cycle;
+    bool resumed;
+    switch (Operation(operation))
+    {
+    case Operation::read:
+        cycle = Card_Event::read_cycle;
+        resumed = m_source_resumed;
+        break;
+    case Operation::punch:
+        cycle = Card_Event::punch_cycle;
+        resumed = m_sink_resumed;
+        break;
+    default:
+        return true;
+    }
+    if (!resumed)
+        return false;
+    end_card_hold();
+
+    // Skip to the end of the cycle in one jump instead of running word times.
+    finish_card_cycles();
+    auto start_time = m_run_time;
+    while (m_card_events.is_pending(cycle))
+    {
+        auto wait = m_card_events.next_time() - m_card_events.now();
+        auto word_times = (wait + microseconds_per_word_time - 1)/microseconds_per_word_time;
+        m_run_time += word_times;
+        m_drum.step(word_times);
+        finish_card_cycles();
+    }
+    if (m_run_time > start_time)
+        add_card_stall(operation, false, Card_Hold::unknown, m_run_time - start_time);
+    return true;
+}
+
+void Computer::Card_Stalls::Counter::add(std::int64_t wait)
+{
+    std::size_t bucket = 0;
+    while (bucket + 1 < histogram.size() && wait >> bucket != 0)
+        ++bucket;
+    ++histogram[bucket];
+    ++n_waits;
+    word_times += wait;
+}
+
+void Computer::add_card_stall(int operation, bool held, Card_Hold hold,
+                              std::int64_t word_times)
+{
+    auto add = [&](Card_Stalls::Counts& counts) {
+        (held ? counts.held[static_cast<std::size_t>(hold)] : counts.interlock).add(word_times);
+    };
+    add(Operation(operation) == Operation::read ? m_card_stalls.read : m_card_stalls.punch);
+    add(m_card_stalls.by_address[m_instruction_address]);
+}
+
+void Computer::hold_for_card_unit(int operation, TTime end_time)
+{
+    Card_Hold hold = Card_Hold::unknown;
+    if (Operation(operation) == Operation::read)
+    {
+        if (auto source = m_source.lock())
+            hold = source->source_hold();
+    }
+    else if (auto sink = m_sink.lock())
+        hold = sink->sink_hold();
+
+    // A change of reason, e.g. from the reader being stopped to its hopper running out,
+    // starts a new wait.
+    if (m_card_held && hold != m_card_hold)
+        end_card_hold();
+    if (!m_card_held)
+    {
+        m_card_held = true;
+        m_card_hold = hold;
+        m_card_hold_time = 0;
     }
+    if (end_time != std::numeric_limits<TTime>::max())
+        m_card_hold_time += end_time - m_run_time;
+}
+
+void Computer::end_card_hold()
+{
+    if (!m_card_held)
+        return;
+    add_card_stall(m_operation_register.value(), true, m_card_hold, m_card_hold_time);
+    m_card_held = false;
+}
+
+const Computer::Card_Stalls& Computer::card_stalls() const
+{
+    return m_card_stalls;
+}
 
+void Computer::finish_card_cycles()
+{
+    Card_Event event;
+    while (m_card_events.pop(TClock(m_run_time)*microseconds_per_word_time, event))
+        LOG(trace) << m_run_time << " card cycle done: " << static_cast<int>(event);
+}
+
+Computer::Run_Status Computer::run(TTime end_time, const Run_Condition& done)
+{
+    Run_Status status;
     while (true)
     {
+        if (should_pause(end_time, done, status))
+            return status;
         if (m_half_cycle == Half_Cycle::instruction)
         {
             LOG(trace) << "I";
@@ -812,13 +1234,22 @@ void Computer::program_start()
                 m_drum.step();
             }
             if (m_cycle_mode == Half_Cycle_Mode::half)
-                return;
+                return Run_Status::half_cycle;
+            if (should_pause(end_time, done, status))
+                return status;
         }
         // m_half_cycle changes during execution.  The ifs are not exclusive.
         if (m_half_cycle == Half_Cycle::data)
         {
             Operation operation = Operation(m_operation_register.value());
             LOG(trace) << "D: op=" << static_cast<int>(operation);
+            // The operation register is kept while waiting so the instruction can run when
+            // the program is continued.
+            if (!wait_for_card_unit(static_cast<int>(operation)))
+            {
+                hold_for_card_unit(static_cast<int>(operation), end_time);
+                return Run_Status::card_wait;
+            }
             m_operation_register.clear();
 
             bool restarted = false;
@@ -850,15 +1281,38 @@ void Computer::program_start()
                 m_drum.step();
             }
             //! Don't stop on op=stop if m_programmed_mode is not "stop".
-            if (m_cycle_mode == Half_Cycle_Mode::half
-                || operation == Operation::stop
-                || (m_overflow && m_overflow_mode == Overflow_Mode::stop)
-                || m_error_stop)
-                return;
+            if (operation == Operation::stop)
+                return Run_Status::stopped;
+            if (m_overflow && m_overflow_mode == Overflow_Mode::stop)
+                return Run_Status::overflow;
+            if (m_error_stop)
+                return Run_Status::error;
+            if (m_cycle_mode == Half_Cycle_Mode::half)
+                return Run_Status::half_cycle;
         }
     }
 }
 
+void Computer::connect_source(std::weak_ptr<Source> source)
+{
+    m_source = source;
+}
+
+void Computer::resume_source_client()
+{
+    m_source_resumed = true;
+}
+
+void Computer::connect_sink(std::weak_ptr<Sink> sink)
+{
+    m_sink = sink;
+}
+
+void Computer::resume_sink_client()
+{
+    m_sink_resumed = true;
+}
+
 void Computer::program_reset()
 {
     m_program_register.fill(0);
@@ -872,6 +1326,12 @@ void Computer::program_reset()
     m_clocking_error = false;
     m_half_cycle = Half_Cycle::instruction;
     m_run_time = 0;
+    // The card cycle clock follows the run time, so it starts over too.
+    m_card_events = Scheduler<Card_Event>();
+    m_card_stalls = Card_Stalls();
+    m_card_held = false;
+    // A stop pressed while nothing ran belongs to the last program, not the next one.
+    m_stop_request.requested = false;
 }
 
 void Computer::computer_reset()
@@ -980,7 +1440,7 @@ bool Computer::error_sense() const
     return m_error_sense;
 }
 
-int Computer::run_time() const
+TTime Computer::run_time() const
 {
     return m_run_time;
 }
@@ -1080,21 +1540,231 @@ Word Computer::get_drum(const Address& address) const
     return m_drum.get_storage(band_of_address(address), index_of_address(address));
 }
 
+void Computer::save_machine(Snapshot::Writer& snapshot) const
+{
+    m_power_events.save(snapshot);
+    put_small(snapshot, m_blower_on);
+    put_small(snapshot, m_can_turn_on);
+    put_small(snapshot, m_power_on);
+    put_small(snapshot, m_dc_on);
+
+    put_small(snapshot, m_programmed_mode);
+    put_small(snapshot, m_control_mode);
+    put_small(snapshot, m_cycle_mode);
+    put_small(snapshot, m_display_mode);
+    put_small(snapshot, m_overflow_mode);
+    put_small(snapshot, m_error_mode);
+    put_register(snapshot, m_storage_entry);
+    put_register(snapshot, m_address_entry);
+
+    put_register(snapshot, m_distributor);
+    put_register(snapshot, m_upper_accumulator);
+    put_register(snapshot, m_lower_accumulator);
+    put_register(snapshot, m_program_register);
+    put_register(snapshot, m_operation_register);
+    put_register(snapshot, m_address_register);
+
+    put_small(snapshot, m_half_cycle);
+    put_count(snapshot, m_run_time);
+    put_small(snapshot, m_restart);
+
+    put_small(snapshot, m_overflow);
+    put_small(snapshot, m_storage_selection_error);
+    put_small(snapshot, m_clocking_error);
+    put_small(snapshot, m_error_sense);
+    put_small(snapshot, m_error_stop);
+
+    m_card_events.save(snapshot);
+    put_small(snapshot, m_source_resumed);
+    put_small(snapshot, m_sink_resumed);
+}
+
+void Computer::load_machine(Snapshot::Reader& snapshot)
+{
+    m_power_events.load(snapshot);
+    get_small(snapshot, m_blower_on);
+    get_small(snapshot, m_can_turn_on);
+    get_small(snapshot, m_power_on);
+    get_small(snapshot, m_dc_on);
+
+    get_small(snapshot, m_programmed_mode);
+    get_small(snapshot, m_control_mode);
+    get_small(snapshot, m_cycle_mode);
+    get_small(snapshot, m_display_mode);
+    get_small(snapshot, m_overflow_mode);
+    get_small(snapshot, m_error_mode);
+    get_register(snapshot, m_storage_entry);
+    get_register(snapshot, m_address_entry);
+
+    get_register(snapshot, m_distributor);
+    get_register(snapshot, m_upper_accumulator);
+    get_register(snapshot, m_lower_accumulator);
+    get_register(snapshot, m_program_register);
+    get_register(snapshot, m_operation_register);
+    get_register(snapshot, m_address_register);
+
+    get_small(snapshot, m_half_cycle);
+    get_count(snapshot, m_run_time);
+    get_small(snapshot, m_restart);
+
+    get_small(snapshot, m_overflow);
+    get_small(snapshot, m_storage_selection_error);
+    get_small(snapshot, m_clocking_error);
+    get_small(snapshot, m_error_sense);
+    get_small(snapshot, m_error_stop);
+
+    m_card_events.load(snapshot);
+    get_small(snapshot, m_source_resumed);
+    get_small(snapshot, m_sink_resumed);
+    // A hold in progress belongs to the program that was replaced.
+    m_card_held = false;
+}
+
+void Computer::save_state(std::ostream& os) const
+{
+    Snapshot::Writer snapshot;
+    save_machine(snapshot);
+    m_drum.save_state(snapshot);
+    snapshot.write(os, snapshot_format, snapshot_version);
+}
+
+void Computer::load_state(std::istream& is)
+{
+    Snapshot::Reader snapshot(is, snapshot_format, snapshot_version);
+    // Fill in a copy so this computer is unchanged if the snapshot is bad.
+    Computer c(*this);
+    c.load_machine(snapshot);
+    c.m_drum.load_state(snapshot);
+    snapshot.finish();
+    *this = c;
+}
+
+void Computer::save_changes(std::ostream& os)
+{
+    Snapshot::Writer snapshot;
+    save_machine(snapshot);
+    m_drum.save_changes(snapshot);
+    snapshot.write(os, changes_format, snapshot_version);
+    m_drum.clear_changes();
+}
+
+void Computer::load_changes(std::istream& is)
+{
+    Snapshot::Reader snapshot(is, changes_format, snapshot_version);
+    Computer c(*this);
+    c.load_machine(snapshot);
+    c.m_drum.load_changes(snapshot);
+    snapshot.finish();
+    *this = c;
+}
+
+void Computer::forget_changes()
+{
+    m_drum.clear_changes();
+}
+
+std::uint64_t Computer::state_hash() const
+{
+    // Registers and flags have keys after the drum's word numbers.
+    auto key = n_bands*band_size;
+    auto h = m_drum.hash();
+    h ^= hash_register(key++, m_distributor);
+    h ^= hash_register(key++, m_upper_accumulator);
+    h ^= hash_register(key++, m_lower_accumulator);
+    h ^= hash_register(key++, m_program_register);
+    h ^= hash_register(key++, m_operation_register);
+    h ^= hash_register(key++, m_address_register);
+    std::uint64_t flags = static_cast<std::uint64_t>(m_half_cycle)
+        | m_restart << 1
+        | m_overflow << 2
+        | m_storage_selection_error << 3
+        | m_clocking_error << 4
+        | m_error_sense << 5
+        | m_error_stop << 6
+        | m_drum.index() << 8
+        | m_source_resumed << 16
+        | m_sink_resumed << 17;
+    return h ^ mix(key ^ mix(flags));
+}
+
+bool Computer::drum_changed(const Address& address) const
+{
+    return m_drum.changed(band_of_address(address), index_of_address(address));
+}
+
+void Computer::attach_drum_file(const std::string& path)
+{
+    m_drum.attach_file(path);
+}
+
+void Computer::detach_drum_file()
+{
+    m_drum.detach_file();
+}
+
+void Computer::flush_drum_file()
+{
+    m_drum.flush_file();
+}
+
+Computer::Drum::Drum()
+    : m_memory({0})
+{
+    m_words = m_memory.data();
+}
+
+Computer::Drum::Drum(const Drum& drum)
+    : m_index(drum.m_index),
+      m_hash(drum.m_hash),
+      m_changed_bands(drum.m_changed_bands),
+      m_changed_words(drum.m_changed_words)
+{
+    m_words = m_memory.data();
+    std::copy(drum.m_words, drum.m_words + n_bytes, m_words);
+}
+
+Computer::Drum& Computer::Drum::operator=(const Drum& drum)
+{
+    if (&drum != this)
+    {
+        std::copy(drum.m_words, drum.m_words + n_bytes, m_words);
+        m_index = drum.m_index;
+        m_hash = drum.m_hash;
+        m_changed_bands = drum.m_changed_bands;
+        m_changed_words = drum.m_changed_words;
+    }
+    return *this;
+}
+
+Computer::Drum::~Drum()
+{
+}
+
+std::uint8_t* Computer::Drum::word_bytes(std::size_t band, std::size_t index) const
+{
+    assert(band < n_bands);
+    assert(index < band_size);
+    return m_words + (band*band_size + index)*packed_size;
+}
+
 void Computer::Drum::step()
 {
     m_index = (m_index + 1) % band_size;
 }
 
+void Computer::Drum::step(std::size_t n)
+{
+    m_index = (m_index + n) % band_size;
+}
+
 Word Computer::Drum::read(std::size_t band) const
 {
-    assert(band < n_bands);
-    return m_storage[band][m_index];
+    return get_storage(band, m_index);
 }
 
 void Computer::Drum::write(std::size_t band, const Word& word)
 {
-    assert(band < n_bands);
-    m_storage[band][m_index] = word;
+    set_storage(band, m_index, word);
 }
 
 std::size_t Computer::Drum::index() const
@@ -1104,10 +1774,145 @@ std::size_t Computer::Drum::index() const
 
 void Computer::Drum::set_storage(std::size_t band, std::size_t index, const Word& word)
 {
-    m_storage[band][index] = word;
+    m_changed_bands.set(band);
+    m_changed_words[band].set(index);
+    auto word_number = band*band_size + index;
+    auto bytes = word_bytes(band, index);
+    auto packed = pack_word(word.digits().data());
+    m_hash ^= hash_packed(word_number, load_packed(bytes)) ^ hash_packed(word_number, packed);
+    store_packed(bytes, packed);
 }
 
 Word Computer::Drum::get_storage(std::size_t band, std::size_t index) const
 {
-    return m_storage[band][index];
+    Word word;
+    unpack_word(load_packed(word_bytes(band, index)), word.digits().data());
+    return word;
+}
+
+void Computer::Drum::save_state(Snapshot::Writer& snapshot) const
+{
+    put_small(snapshot, m_index);
+    snapshot.put_bytes(reinterpret_cast<const char*>(m_words), n_bytes);
+}
+
+void Computer::Drum::load_state(Snapshot::Reader& snapshot)
+{
+    get_small(snapshot, m_index);
+    if (m_index >= band_size)
+        throw std::runtime_error("bad drum index in snapshot");
+    // The drum is stored as one block of packed words in address order.
+    auto bytes = snapshot.get_bytes(n_bytes);
+    std::copy(bytes, bytes + n_bytes, m_words);
+    rehash();
+    m_changed_bands.set();
+    for (auto& words : m_changed_words)
+        words.set();
+}
+
+void Computer::Drum::save_changes(Snapshot::Writer& snapshot) const
+{
+    put_small(snapshot, m_index);
+    std::size_t n_changed = 0;
+    for (std::size_t band = 0; band < n_bands; ++band)
+        if (m_changed_bands[band])
+            n_changed += m_changed_words[band].count();
+    snapshot.put_count(n_changed);
+    for (std::size_t band = 0; band < n_bands; ++band)
+    {
+        if (!m_changed_bands[band])
+            continue;
+        for (std::size_t index = 0; index < band_size; ++index)
+            if (m_changed_words[band][index])
+            {
+                snapshot.put(static_cast<std::uint16_t>(band*band_size + index));
+                snapshot.put_bytes(reinterpret_cast<const char*>(word_bytes(band, index)),
+                                   packed_size);
+            }
+    }
+}
+
+void Computer::Drum::load_changes(Snapshot::Reader& snapshot)
+{
+    get_small(snapshot, m_index);
+    if (m_index >= band_size)
+        throw std::runtime_error("bad drum index in snapshot");
+    auto n_changed = snapshot.get_count(sizeof(std::uint16_t) + packed_size);
+    for (std::size_t i = 0; i < n_changed; ++i)
+    {
+        std::size_t word_number = snapshot.get<std::uint16_t>();
+        if (word_number >= n_bands*band_size)
+            throw std::runtime_error("bad word number in snapshot");
+        auto band = word_number/band_size;
+        auto index = word_number % band_size;
+        auto bytes = word_bytes(band, index);
+        auto new_bytes = reinterpret_cast<const std::uint8_t*>(snapshot.get_bytes(packed_size));
+        m_hash ^= hash_packed(word_number, load_packed(bytes))
+            ^ hash_packed(word_number, load_packed(new_bytes));
+        std::copy(new_bytes, new_bytes + packed_size, bytes);
+        m_changed_bands.set(band);
+        m_changed_words[band].set(index);
+    }
+}
+
+std::uint64_t Computer::Drum::hash() const
+{
+    return m_hash;
+}
+
+void Computer::Drum::rehash()
+{
+    m_hash = 0;
+    for (std::size_t n = 0; n < n_bands*band_size; ++n)
+        m_hash ^= hash_packed(n, load_packed(m_words + n*packed_size));
+}
+
+bool Computer::Drum::changed(std::size_t band, std::size_t index) const
+{
+    return m_changed_bands[band] && m_changed_words[band][index];
+}
+
+void Computer::Drum::clear_changes()
+{
+    m_changed_bands.reset();
+    for (auto& words : m_changed_words)
+        words.reset();
+}
+
+void Computer::Drum::attach_file(const std::string& path)
+{
+    auto file = std::make_unique<Mapped_File>(path, drum_file_header_size + n_bytes);
+    auto header = file->data();
+    auto file_words = reinterpret_cast<std::uint8_t*>(header + drum_file_header_size);
+    if (file->created())
+    {
+        std::memcpy(header, drum_file_format, sizeof(drum_file_format));
+        std::memcpy(header + sizeof(drum_file_format), &drum_file_version,
+                    sizeof(drum_file_version));
+        std::copy(m_words, m_words + n_bytes, file_words);
+    }
+    else if (std::memcmp(header, drum_file_format, sizeof(drum_file_format)) != 0
+             || std::memcmp(header + sizeof(drum_file_format), &drum_file_version,
+                            sizeof(drum_file_version)) != 0)
+        throw std::runtime_error(path + " is not a drum file of the current version");
+
+    detach_file();
+    m_file = std::move(file);
+    m_words = file_words;
+    rehash();
+}
+
+void Computer::Drum::detach_file()
+{
+    if (!m_file)
+        return;
+    std::copy(m_words, m_words + n_bytes, m_memory.data());
+    m_words = m_memory.data();
+    m_file.reset();
+}
+
+void Computer::Drum::flush_file()
+{
+    if (m_file)
+        m_file->flush();
 }
@@ -1,14 +1,29 @@
 #ifndef COMPUTER_HPP
 #define COMPUTER_HPP
 
+#include "buffer.hpp"
 #include "register.hpp"
+#include "scheduler.hpp"
 
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
+namespace Snapshot
+{
+class Reader;
+class Writer;
+}
+class Mapped_File;
+
 namespace IBM650
 {
-using TTime = int;
+using TTime = std::int64_t;
 
 constexpr std::size_t address_size = 4;
 using Address = Register<address_size>;
@@ -16,10 +31,17 @@ using Address = Register<address_size>;
 constexpr std::size_t band_size = 50;
 /// The number of bands on the drum.  Each band holds band_size words.
 constexpr static size_t n_bands = 40;
+/// Increment when a change to the emulator makes programs run differently, in results or in
+/// word times.  Saved results are not reused after it changes.
+constexpr int timing_model_version = 2;
 
 class Operation_Step;
 
-class Computer
+/// The computer is the client of the card unit's reader and punch.  To connect it, keep the
+/// computer in a shared pointer and connect both ways, e.g.
+///     unit->connect_source_client(computer);
+///     computer->connect_source(unit);
+class Computer : public Source_Client, public Sink_Client
 {
     // Give access to operation steps.
     friend class Instruction_to_Program_Register;
@@ -37,6 +59,8 @@ class Computer
     friend class Look_Up_Address;
     friend class Address_to_Program_Register;
     friend class Insert_Address_in_Lower;
+    friend class Read_Buffer_to_Drum;
+    friend class Punch_Drum_to_Buffer;
 
 public:
     Computer();
@@ -141,13 +165,154 @@ public:
     void set_error();
     Word get_drum(const Address& addr) const;
 
+    // Snapshots
+
+    /// Write the complete state of the machine to the passed-in stream in a compact, versioned
+    /// binary form: switches, registers, error flags, the half-cycle phase, the drum position
+    /// and the drum.  The state should be saved between instructions, when program_start()
+    /// has returned.  See snapshot.hpp for the format.
+    void save_state(std::ostream& os) const;
+    /// Restore the state written by save_state().  Continuing the program from the restored
+    /// state gives the same results as continuing the saved machine.  Throws
+    /// std::runtime_error if the snapshot is not a computer snapshot of the current version,
+    /// or if it's incomplete.  The computer is unchanged if an exception is thrown.
+    void load_state(std::istream& is);
+    /// Write a snapshot like save_state() but with only the drum words that were changed
+    /// since the last call to save_changes() or forget_changes().  Restore a chain of them
+    /// with load_state() for the full snapshot before them, and then load_changes() for each
+    /// in order.
+    void save_changes(std::ostream& os);
+    /// Restore a snapshot written by save_changes() to a machine in the state of the
+    /// snapshot before it.  Throws std::runtime_error like load_state().
+    void load_changes(std::istream& is);
+    /// Start recording drum changes from here.  Call after save_state() to start a chain.
+    void forget_changes();
+    /// @Return true if the word at the passed-in address may have been written since the last
+    /// call to save_changes() or forget_changes().  Restoring a snapshot counts as writing
+    /// the words it restores.
+    bool drum_changed(const Address& address) const;
+
+    // State Hashes
+
+    /// @Return a 64-bit hash of the machine's architectural state: the registers, the error
+    /// flags, the half-cycle phase, the drum position and the drum.  Switches, power and the
+    /// run time are not included, so a program in a loop comes back to the same hash.
+    /// Machines with equal states have equal hashes.  The drum's part is updated with each
+    /// write, so this takes constant time.
+    std::uint64_t state_hash() const;
+
+    // Drum Files
+
+    /// Keep the contents of the drum in the file at path, like the real drum keeps them when
+    /// the power is off.  If the file exists, its contents replace the drum's.  Otherwise
+    /// it's created with the drum's current contents.  Changes are written to the file as
+    /// the program runs but may not reach the disk until flush_drum_file() is called or the
+    /// file is detached.  Copies of the computer get the contents of the drum but not the
+    /// file.  Throws std::runtime_error if the file can't be used.
+    void attach_drum_file(const std::string& path);
+    /// Copy the drum contents back to memory and stop using the file.
+    void detach_drum_file();
+    /// Write changes to the drum file.  Does nothing if there's no file.
+    void flush_drum_file();
+
+    // Bounded Runs
+
+    /// Why a call that runs the program returned.
+    enum class Run_Status
+    {
+        /// A stop instruction was executed.
+        stopped,
+        /// An operation overflowed and the overflow switch is at "stop".
+        overflow,
+        /// An error stopped the program.
+        error,
+        /// The half-cycle switch is at "half" and a half cycle was run.
+        half_cycle,
+        /// The control switch is at "manual", so the manual operation was done instead.
+        manual,
+        /// The word time limit was reached.
+        time_limit,
+        /// The condition passed to run_until() became true.
+        condition,
+        /// program_stop() was called.
+        stop_requested,
+        /// A read or punch instruction is waiting for the card unit to be started.  The
+        /// instruction runs when the program is continued after the unit resumes the computer.
+        card_wait,
+    };
+    using Run_Condition = std::function<bool(const Computer&)>;
+
+    /// Run the program like program_start() for about word_times more word times.  Execution
+    /// pauses at the first half-cycle boundary at or after the limit.  Call again to
+    /// continue.
+    Run_Status run_for(TTime word_times);
+    /// Run the program like program_start() until done() returns true.  done() is checked
+    /// at each half-cycle boundary, including before the first one.
+    Run_Status run_until(const Run_Condition& done);
+
+    // Card Input and Output
+
+    /// The read instruction (70) copies the read buffer to words 01-10 of the band of its
+    /// data address.  The punch instruction (71) copies words 27-36 to the punch buffer.
+    /// Either one waits until the unit has resumed the computer and the card cycle started by
+    /// the last one is over.  Computing overlaps the card cycles, and waits for a cycle skip
+    /// straight to its end.
+    virtual void connect_source(std::weak_ptr<Source> source) override;
+    /// Called by the unit when the next card is in the read buffer.
+    virtual void resume_source_client() override;
+    virtual void connect_sink(std::weak_ptr<Sink> sink) override;
+    /// Called by the unit when it's ready to take a card to punch.
+    virtual void resume_sink_client() override;
+
+    /// Word times that read and punch instructions waited for the card unit.  Shows whether
+    /// a slow program is card-bound, and which card instructions would gain from more
+    /// computing between them or from more buffering.
+    struct Card_Stalls
+    {
+        /// The number of waits and the word times they took.
+        struct Counter
+        {
+            /// Waits by length.  Bucket 0 counts waits of 0 word times, and bucket n counts
+            /// waits of 2^(n-1) to 2^n - 1 word times.  The last bucket also counts longer
+            /// waits.
+            std::array<std::size_t, 32> histogram{};
+            std::size_t n_waits = 0;
+            std::int64_t word_times = 0;
+
+            void add(std::int64_t word_times);
+        };
+        struct Counts
+        {
+            /// Waits for the card cycle started by the last read or punch to end.
+            Counter interlock;
+            /// Waits for the unit to resume the computer, indexed by the unit's Card_Hold
+            /// reason.  The computer's run time doesn't advance while it's held, so the word
+            /// times are those that run_for() was asked to run.  run_until() and unlimited
+            /// runs add waits of 0 word times.
+            std::array<Counter, 4> held;
+        };
+        Counts read;
+        Counts punch;
+        /// The waits of each read or punch instruction that waited, by its address.
+        std::map<int, Counts> by_address;
+    };
+    /// @Return the card stalls since computer or program reset.  Not saved in snapshots.
+    const Card_Stalls& card_stalls() const;
+
     // Console Keys
 
     /// Press the transfer key.  Sets the address register but only in manual control.
     void transfer();
     /// Start program execution.
     void program_start();
-    /// Reset registers and errors to prepare to run a program.
+    /// Press the program stop key.  The running program pauses at the next half-cycle
+    /// boundary, and the call that ran it returns Run_Status::stop_requested.  Safe to call
+    /// from another thread while the program runs.  If no program is running, the request
+    /// waits for the next call that runs one, which returns without running it, unless
+    /// program or computer reset clears it first.
+    void program_stop();
+    /// Reset registers and errors, and clear a pending stop request, to prepare to run a
+    /// program.
     void program_reset();
     /// Full reset: roughly equivalent to doing the three other resets.
     void computer_reset();
@@ -192,36 +357,38 @@ public:
     bool error_sense() const;
 
     /// The number of word times since computer or program reset.
-    int run_time() const;
+    TTime run_time() const;
 
 private:
     /// Write a word to a storage address.
     void set_storage(const Address& address, const Word& word);
     /// @Return the word in the passed-in address.
     const Word get_storage(const Address& address) const;
-
-    /// The number of seconds that have passed since main power was turned on or off.
-    TTime m_elapsed_seconds;
-    /// True until master power is turned off.
-    bool m_can_turn_on;
-    /// True when main power is on.
-    bool m_power_on;
-    /// True when DC power is on.
-    bool m_dc_on;
-
-    Programmed_Mode m_programmed_mode;
-    /// The state of the control switch.
-    Control_Mode m_control_mode;
-    /// The state of the half-cycle switch.
-    Half_Cycle_Mode m_cycle_mode;
-    /// The state of the display switch.
-    Display_Mode m_display_mode;
-    Overflow_Mode m_overflow_mode;
-    Error_Mode m_error_mode;
-    /// The state of the storage entry switches.
-    Word m_storage_entry;
-    /// The state of the address switches.
-    Address m_address_entry;
+    /// Do the manual operation selected by the display switch.
+    void manual_operation();
+    /// Run half cycles until the program stops or pauses.
+    Run_Status run(TTime end_time, const Run_Condition& done);
+    /// @Return true and set status if the program should pause at this half-cycle boundary.
+    bool should_pause(TTime end_time, const Run_Condition& done, Run_Status& status);
+    /// Wait for the card unit if the operation is a read or punch.  Skips the run time
+    /// ahead if a card cycle is in progress.  @Return false if the unit hasn't resumed the
+    /// computer, so the program can't continue.
+    bool wait_for_card_unit(int operation);
+    /// Remove card cycle events that are over by the current run time.
+    void finish_card_cycles();
+    /// Count word times that the instruction at m_instruction_address waited for the card
+    /// unit.  If held, the wait is for the unit to resume the computer for the passed-in
+    /// reason, otherwise it's for a card cycle to end.
+    void add_card_stall(int operation, bool held, Card_Hold hold, std::int64_t word_times);
+    /// Note that the read or punch is held waiting for the unit to resume the computer.  A
+    /// run that was to end at end_time adds its word times to the hold.
+    void hold_for_card_unit(int operation, TTime end_time);
+    /// Count the current hold, if any, as one wait.
+    void end_card_hold();
+
+    // The state used by every instruction is kept together at the start of the object so it
+    // takes as few cache lines as possible: the registers and flags, and then the drum's
+    // pointer and position.  Switches and power come after the drum's storage.
 
     // Registers
 
@@ -232,13 +399,13 @@ private:
     Register<2> m_operation_register;
     Address m_address_register;
 
-    enum class Half_Cycle
+    enum class Half_Cycle : std::uint8_t
     {
         data,
         instruction,
     };
     Half_Cycle m_half_cycle;
-    int m_run_time;
+    TTime m_run_time;
     bool m_restart;
 
     // Error flags
@@ -250,11 +417,33 @@ private:
     /// True if an error that unconditionally stops the program occurred.
     bool m_error_stop;
 
+    /// A stop request that may be set from another thread.  Copies of the computer start
+    /// without a request.
+    struct Stop_Request
+    {
+        Stop_Request() = default;
+        Stop_Request(const Stop_Request&) {}
+        Stop_Request& operator=(const Stop_Request&) { return *this; }
+        std::atomic<bool> requested = false;
+    };
+    Stop_Request m_stop_request;
+
     class Drum
     {
     public:
+        Drum();
+        /// Copy the contents and position of the passed-in drum.  The copy is kept in memory
+        /// even if the passed-in drum has a file.
+        Drum(const Drum& drum);
+        /// Copy the contents and position of the passed-in drum.  If this drum has a file, it
+        /// keeps it and the contents are written to it.
+        Drum& operator=(const Drum& drum);
+        ~Drum();
+
         /// Rotate the drum by one word.
         void step();
+        /// Rotate the drum by n words.
+        void step(std::size_t n);
         /// @Return the word at the read head in the passed-in band.
         Word read(std::size_t band) const;
         /// Set the word at the read head in the passed-in band.
@@ -266,15 +455,118 @@ private:
         void set_storage(std::size_t band, std::size_t index, const Word& word);
         Word get_storage(std::size_t band, std::size_t index) const;
 
+        void save_state(Snapshot::Writer& snapshot) const;
+        void load_state(Snapshot::Reader& snapshot);
+        /// Save the words changed since the last call to clear_changes().
+        void save_changes(Snapshot::Writer& snapshot) const;
+        void load_changes(Snapshot::Reader& snapshot);
+        void clear_changes();
+        bool changed(std::size_t band, std::size_t index) const;
+        /// @Return the hash of the words on the drum.
+        std::uint64_t hash() const;
+
+        void attach_file(const std::string& path);
+        void detach_file();
+        void flush_file();
+
     private:
-        /// The words stored on the drum.
-        std::array<std::array<Word, band_size>, n_bands> m_storage;
+        /// The number of bytes in a packed word.  See pack_word() in computer.cpp.
+        static constexpr std::size_t packed_size = 6;
+        static constexpr std::size_t n_bytes = n_bands*band_size*packed_size;
+        /// @Return a pointer to the packed word at band and index.
+        std::uint8_t* word_bytes(std::size_t band, std::size_t index) const;
+        /// Compute m_hash from scratch.
+        void rehash();
+
+        // Members used for every read and write come first.
+
+        /// The packed words stored on the drum in address order.  Points into m_memory or
+        /// m_file.
+        std::uint8_t* m_words;
         /// The drum position, 0-49.  Determines which addresses are at the read head.
         std::size_t m_index = 0;
+        /// The XOR of the hashes of the words on the drum.  A word's hash depends on its
+        /// address and its contents.  Writing a word XORs out the old word's hash and XORs in
+        /// the new one.
+        std::uint64_t m_hash = 0;
+        /// Bands with words that were changed since the last call to clear_changes().  Lets
+        /// save_changes() skip the rest.
+        std::bitset<n_bands> m_changed_bands;
+        /// The changed words in each band.
+        std::array<std::bitset<band_size>, n_bands> m_changed_words;
+        /// The drum file, if any.
+        std::unique_ptr<Mapped_File> m_file;
+        /// The words stored on the drum, when there's no file.
+        std::array<std::uint8_t, n_bytes> m_memory;
     };
 
+    void save_machine(Snapshot::Writer& snapshot) const;
+    void load_machine(Snapshot::Reader& snapshot);
+
     Drum m_drum;
 
+    // Card unit connections and interlocks
+
+    enum class Card_Event : std::uint8_t
+    {
+        read_cycle,
+        punch_cycle,
+    };
+    /// The ends of card cycles in progress, on a clock that follows the run time.  Program
+    /// reset ends them.
+    Scheduler<Card_Event> m_card_events;
+    std::weak_ptr<Source> m_source;
+    std::weak_ptr<Sink> m_sink;
+    /// True if the reader has resumed the computer since the last read.
+    bool m_source_resumed = false;
+    /// True if the punch has resumed the computer since the last punch.
+    bool m_sink_resumed = false;
+
+    // Card stall accounting.  Not part of the machine's state.
+
+    Card_Stalls m_card_stalls;
+    /// The address of the last instruction loaded into the program register.
+    int m_instruction_address = 0;
+    /// True while a read or punch is held waiting for the unit.
+    bool m_card_held = false;
+    /// The reason the unit gave for the hold, and the word times it has lasted.
+    Card_Hold m_card_hold = Card_Hold::unknown;
+    std::int64_t m_card_hold_time = 0;
+
+    // Console and power state
+
+    /// Power sequencing events that happen on their own some time after a key is pressed.
+    enum class Power_Event : std::uint8_t
+    {
+        dc_on,
+        blower_off,
+    };
+    void handle(Power_Event event);
+    /// Pending power events on a clock that's advanced by step().
+    Scheduler<Power_Event> m_power_events;
+    /// True while the blower runs.
+    bool m_blower_on;
+    /// True until master power is turned off.
+    bool m_can_turn_on;
+    /// True when main power is on.
+    bool m_power_on;
+    /// True when DC power is on.
+    bool m_dc_on;
+
+    Programmed_Mode m_programmed_mode;
+    /// The state of the control switch.
+    Control_Mode m_control_mode;
+    /// The state of the half-cycle switch.
+    Half_Cycle_Mode m_cycle_mode;
+    /// The state of the display switch.
+    Display_Mode m_display_mode;
+    Overflow_Mode m_overflow_mode;
+    Error_Mode m_error_mode;
+    /// The state of the storage entry switches.
+    Word m_storage_entry;
+    /// The state of the address switches.
+    Address m_address_entry;
+
     // Support for multiply and divide loops.
     void add_to_accumulator(const Word& reg, bool to_upper, TDigit& carry);
     void shift_accumulator(int n_places_left);
@@ -0,0 +1,182 @@
+#include "../bounded_queue.hpp"
+#include "../job.hpp"
+#include "../result_cache.hpp"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A long-lived job server.  Clients connect to a Unix-domain socket, send a job in the text
+// format described in job.hpp, and get back the result.  One job per connection.
+//
+//   IBM650d <socket path> [workers] [word time quota] [time slice] [cache directory]
+
+static constexpr IBM650::TTime default_quota = 100'000'000;
+static constexpr IBM650::TTime default_time_slice = 1'000'000;
+/// The number of connections served at once.  More wait to be accepted.
+static constexpr std::size_t max_connections = 64;
+/// How long a client may take to send its request.
+static constexpr int request_timeout_seconds = 30;
+/// The longest request accepted.  A full drum image is well under this.
+static constexpr std::size_t max_request_size = 16 << 20;
+
+/// Set when SIGINT or SIGTERM is received.
+static volatile std::sig_atomic_t stopping = 0;
+
+static void stop(int)
+{
+    stopping = 1;
+}
+
+/// Set n to the number in s.  @Return false if s isn't a number in T's range with no other
+/// characters.
+template <typename T>
+static bool parse(const char* s, T& n)
+{
+    auto end = s + std::strlen(s);
+    auto [p, error] = std::from_chars(s, end, n);
+    return error == std::errc() && p == end && p != s;
+}
+
+static int usage(const char* program)
+{
+    std::cerr << "usage: " << program << " <socket path> [workers] [word time quota]"
+              << " [time slice] [cache directory]\n";
+    return 1;
+}
+
+/// @Return the request sent by the client, up to and including the "run" line.
+static std::string read_request(int fd)
+{
+    // Give up on clients that don't send a request, so they can't hold a connection thread.
+    timeval timeout{request_timeout_seconds, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        request.append(buffer, n);
+        if (request.size() > max_request_size)
+            throw std::runtime_error("request too large");
+        if (request.find("\nrun") != std::string::npos || request.rfind("run", 0) == 0)
+            break;
+    }
+    return request;
+}
+
+static void write_all(int fd, const std::string& s)
+{
+    for (std::size_t done = 0; done < s.size(); )
+    {
+        // Don't let a client that hangs up kill the server with SIGPIPE.
+        auto n = send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        done += n;
+    }
+}
+
+static void serve(int fd, IBM650::Job_Server& server)
+{
+    std::ostringstream response;
+    try
+    {
+        std::istringstream is(read_request(fd));
+        auto job = IBM650::read_job(is);
+        std::promise<IBM650::Job_Result> promise;
+        auto result = promise.get_future();
+        server.submit(job, [&promise](const IBM650::Job_Result& r) { promise.set_value(r); });
+        IBM650::write_result(response, result.get());
+    }
+    catch (const std::exception& e)
+    {
+        IBM650::Job_Result failed;
+        failed.status = IBM650::Job_Result::Status::failed;
+        failed.message = e.what();
+        IBM650::write_result(response, failed);
+    }
+    write_all(fd, response.str());
+    close(fd);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return usage(argv[0]);
+    std::string path = argv[1];
+    std::size_t n_workers = std::thread::hardware_concurrency();
+    auto quota = default_quota;
+    auto time_slice = default_time_slice;
+    if ((argc > 2 && !parse(argv[2], n_workers))
+        || (argc > 3 && (!parse(argv[3], quota) || quota <= 0))
+        || (argc > 4 && (!parse(argv[4], time_slice) || time_slice < 0)))
+        return usage(argv[0]);
+    auto cache = argc > 5 ? std::make_shared<IBM650::Result_Cache>(argv[5]) : nullptr;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "can't make socket " << path << '\n';
+        return 1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listener, SOMAXCONN) < 0)
+    {
+        std::cerr << "can't listen on " << path << ": " << std::strerror(errno) << '\n';
+        return 1;
+    }
+
+    // No SA_RESTART, so a signal interrupts accept() and the server shuts down.
+    struct sigaction action{};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    // Writes to clients that have gone away fail with EPIPE instead.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    IBM650::Job_Server server(std::max(n_workers, std::size_t(1)), quota, time_slice, cache);
+    // Connections just wait for their results.  The server's workers limit how many jobs run
+    // at once, and the connection threads limit how many clients are served.  Accepting
+    // waits while they're all busy.
+    Bounded_Queue<int> connections(max_connections);
+    std::vector<std::thread> handlers;
+    for (std::size_t i = 0; i < max_connections; ++i)
+        handlers.emplace_back([&connections, &server] {
+            int fd;
+            while (connections.pop(fd))
+                serve(fd, server);
+        });
+
+    while (!stopping)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd >= 0)
+            connections.push(fd);
+    }
+
+    // Serve the accepted connections before the server goes away.
+    connections.close();
+    for (auto& handler : handlers)
+        handler.join();
+    close(listener);
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "deck_file.hpp"
+#include "mapped_file.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace IBM533;
+
+namespace
+{
+const char deck_file_format[] = {'D', 'E', 'C', 'K'};
+const std::uint16_t deck_file_version = 2;
+const std::size_t deck_file_header_size = 8;
+const std::size_t card_bytes = Packed_Card::n_bytes;
+
+void write_header(std::ostream& os)
+{
+    char header[deck_file_header_size] = {};
+    std::memcpy(header, deck_file_format, sizeof(deck_file_format));
+    std::memcpy(header + sizeof(deck_file_format), &deck_file_version,
+                sizeof(deck_file_version));
+    os.write(header, deck_file_header_size);
+}
+
+/// Throw if the header isn't a deck file header of the current version.
+void check_header(const char* header, std::size_t size, const std::string& path)
+{
+    if (size < deck_file_header_size
+        || std::memcmp(header, deck_file_format, sizeof(deck_file_format)) != 0)
+        throw std::runtime_error(path + " is not a deck file");
+    std::uint16_t version;
+    std::memcpy(&version, header + sizeof(deck_file_format), sizeof(version));
+    if (version != deck_file_version)
+        throw std::runtime_error("unsupported deck file version " + std::to_string(version));
+}
+
+void write_card(std::ostream& os, const Card& card)
+{
+    Packed_Card packed(card);
+    os.write(reinterpret_cast<const char*>(packed.bytes().data()), card_bytes);
+}
+
+/// Open a deck file for appending.  Write a header if the file is new.
+std::shared_ptr<std::ofstream> open_deck_file(const std::string& path)
+{
+    char header[deck_file_header_size];
+    std::size_t size = 0;
+    if (std::ifstream is{path, std::ios::binary})
+    {
+        is.read(header, deck_file_header_size);
+        size = is.gcount();
+    }
+    auto os = std::make_shared<std::ofstream>(path, std::ios::binary | std::ios::app);
+    if (!*os)
+        throw std::runtime_error("can't open deck file " + path);
+    if (size == 0)
+        write_header(*os);
+    else
+        check_header(header, size, path);
+    return os;
+}
+}
+
+void IBM533::write_deck_file(const std::string& path, const Card_Deck& deck)
+{
+    std::ofstream os(path, std::ios::binary);
+    write_header(os);
+    for (const auto& card : deck)
+        write_card(os, card);
+    if (!os.flush())
+        throw std::runtime_error("can't write deck file " + path);
+}
+
+Card_Writer IBM533::deck_file_writer(const std::string& path)
+{
+    auto os = open_deck_file(path);
+    return [os, path](const Card& card) {
+        write_card(*os, card);
+        if (!*os)
+            throw std::runtime_error("can't write deck file " + path);
+    };
+}
+
+Card_Reader IBM533::deck_file_reader(const std::string& path)
+{
+    auto file = std::make_shared<Mapped_File>(path);
+    check_header(file->data(), file->size(), path);
+    if ((file->size() - deck_file_header_size) % card_bytes != 0)
+        throw std::runtime_error(path + " has a partial card");
+
+    std::size_t offset = deck_file_header_size;
+    return [file, offset](Card& card) mutable {
+        if (offset == file->size())
+            return false;
+        Packed_Card packed;
+        std::memcpy(packed.bytes().data(), file->data() + offset, card_bytes);
+        card = packed.unpack();
+        offset += card_bytes;
+        return true;
+    };
+}
+
+Deck_File_Writer::Deck_File_Writer(const std::string& path, std::size_t batch_size,
+                                   std::size_t queue_depth)
+    : m_path(path),
+      m_batch_size(batch_size),
+      m_os(open_deck_file(path)),
+      m_queue(queue_depth)
+{
+    assert(batch_size > 0);
+    m_batch.cards.reserve(m_batch_size);
+    m_thread = std::thread(&Deck_File_Writer::run, this);
+}
+
+Deck_File_Writer::~Deck_File_Writer()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+}
+
+void Deck_File_Writer::write(const Card& card)
+{
+    check();
+    if (!m_thread.joinable())
+        throw std::runtime_error("deck file " + m_path + " is closed");
+    m_batch.cards.emplace_back(card);
+    if (m_batch.cards.size() == m_batch_size)
+        pass(false);
+}
+
+void Deck_File_Writer::flush()
+{
+    if (!m_thread.joinable())
+        return;
+    std::size_t n_flushes;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        n_flushes = ++m_n_flushes;
+    }
+    pass(true);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_flushed.wait(lock, [this, n_flushes] { return m_n_flushed >= n_flushes; });
+    lock.unlock();
+    check();
+}
+
+void Deck_File_Writer::close()
+{
+    if (!m_thread.joinable())
+        return;
+    // Stop the thread even if the flush throws.
+    try
+    {
+        flush();
+    }
+    catch (const std::runtime_error&)
+    {
+        m_queue.close();
+        m_thread.join();
+        throw;
+    }
+    m_queue.close();
+    m_thread.join();
+}
+
+Card_Writer Deck_File_Writer::card_writer()
+{
+    return [this](const Card& card) { write(card); };
+}
+
+Card_Flush Deck_File_Writer::card_flush()
+{
+    return [this] { flush(); };
+}
+
+void Deck_File_Writer::pass(bool flush)
+{
+    m_batch.flush = flush;
+    if (!m_queue.push(std::move(m_batch)))
+        throw std::runtime_error("deck file " + m_path + " is closed");
+    m_batch = Batch();
+    m_batch.cards.reserve(m_batch_size);
+}
+
+void Deck_File_Writer::check() const
+{
+    if (m_failed)
+        throw std::runtime_error("can't write deck file " + m_path);
+}
+
+void Deck_File_Writer::run()
+{
+    static_assert(sizeof(Packed_Card) == card_bytes);
+    Batch batch;
+    while (m_queue.pop(batch))
+    {
+        // Packed cards are contiguous in the batch, so the whole batch is one write.
+        if (!m_failed)
+        {
+            m_os->write(reinterpret_cast<const char*>(batch.cards.data()),
+                        batch.cards.size()*card_bytes);
+            if (batch.flush)
+                m_os->flush();
+            if (!*m_os)
+                m_failed = true;
+        }
+        if (batch.flush)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_n_flushed;
+            }
+            m_flushed.notify_all();
+        }
+    }
+}
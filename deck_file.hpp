@@ -0,0 +1,97 @@
+#ifndef DECK_FILE_HPP
+#define DECK_FILE_HPP
+
+#include "bounded_queue.hpp"
+#include "input_output_unit.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace IBM533
+{
+/// Deck files hold cards for streaming into the read hopper.  A file starts with a format
+/// tag and version, padded to 8 bytes.  The cards follow in order in their packed form, 120
+/// bytes each.  See Packed_Card.
+
+/// Write a deck to a file.  Throws std::runtime_error if the file can't be written.
+void write_deck_file(const std::string& path, const Card_Deck& deck);
+/// @Return a writer that appends cards to a deck file, e.g. for a spilling stacker.  The
+/// file is created if it doesn't exist.  Cards are buffered, and are all in the file when the
+/// last copy of the writer is destroyed.  Throws std::runtime_error if the file can't be
+/// opened or isn't a deck file.  The writer throws if a card can't be written.
+Card_Writer deck_file_writer(const std::string& path);
+/// @Return a reader that pulls cards from a deck file in order.  The file is mapped
+/// read-only, so the cards are read from the page cache as they're pulled instead of being
+/// loaded up front.  The reader keeps the mapping open.  Throws std::runtime_error if the
+/// file can't be mapped or isn't a deck file.
+Card_Reader deck_file_reader(const std::string& path);
+
+/// Appends cards to a deck file from a background thread, so that a program that punches
+/// heavily doesn't wait for the disk.  Cards are collected in batches.  Each full batch is
+/// passed to the thread, which writes it to the file in one piece.  At most queue_depth
+/// batches wait to be written.  If the disk falls further behind than that, passing on a
+/// batch waits for room, so memory use stays bounded.
+///
+/// The cards are only certain to be in the file after flush() or close().  Connect the
+/// writer to a stacker with
+///     unit.spill_punch_stacker(writer.card_writer(), 0, writer.card_flush());
+/// so that it's flushed whenever the unit stops.  The writer must outlive the connection.
+class Deck_File_Writer
+{
+public:
+    /// Open a deck file for appending like deck_file_writer(), and start the thread.
+    Deck_File_Writer(const std::string& path, std::size_t batch_size = 256,
+                     std::size_t queue_depth = 8);
+    /// Calls close().  Write errors are not reported.
+    ~Deck_File_Writer();
+
+    /// Add a card to the batch.  Must be called from one thread at a time.  Throws
+    /// std::runtime_error if the writer was closed or if an earlier batch couldn't be
+    /// written.
+    void write(const Card& card);
+    /// Pass on the batch, even if it's not full, and wait for all cards to be written and
+    /// flushed to the file.  Throws std::runtime_error if any couldn't be written.
+    void flush();
+    /// Flush and stop the thread.  Nothing more can be written.
+    void close();
+
+    /// @Return a function that calls write().
+    Card_Writer card_writer();
+    /// @Return a function that calls flush().
+    Card_Flush card_flush();
+
+private:
+    struct Batch
+    {
+        Packed_Deck cards;
+        /// True if the file is to be flushed after writing the cards.
+        bool flush = false;
+    };
+    void run();
+    /// Pass the batch to the thread.
+    void pass(bool flush);
+    /// Throw if a batch couldn't be written.
+    void check() const;
+
+    std::string m_path;
+    std::size_t m_batch_size;
+    std::shared_ptr<std::ofstream> m_os;
+    Batch m_batch;
+    Bounded_Queue<Batch> m_queue;
+    std::thread m_thread;
+    std::atomic<bool> m_failed = false;
+
+    /// Counts of flushes passed on and done, for waiting in flush().
+    std::size_t m_n_flushes = 0;
+    std::size_t m_n_flushed = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_flushed;
+};
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include "input_output_thread.hpp"
+
+#include <stdexcept>
+
+using namespace IBM533;
+
+class Input_Output_Thread::Unit_Client : public Source_Client, public Sink_Client
+{
+public:
+    Unit_Client(Input_Output_Thread& owner)
+        : m_owner(owner)
+    {}
+
+    virtual void connect_source(std::weak_ptr<Source>) override {}
+    virtual void resume_source_client() override {
+        // The unit reads the next card into its other buffer, so this one can be shared.
+        m_owner.signal({Signal::resume_source, &m_owner.m_unit->get_source()});
+    }
+    virtual void connect_sink(std::weak_ptr<Sink>) override {}
+    virtual void resume_sink_client() override {
+        m_owner.signal({Signal::resume_sink});
+    }
+
+private:
+    Input_Output_Thread& m_owner;
+};
+
+Input_Output_Thread::Input_Output_Thread(std::shared_ptr<Input_Output_Unit> unit)
+    : m_unit(unit),
+      m_unit_client(std::make_shared<Unit_Client>(*this))
+{
+    m_unit->connect_source_client(m_unit_client);
+    m_unit->connect_sink_client(m_unit_client);
+    m_thread = std::thread(&Input_Output_Thread::run, this);
+}
+
+Input_Output_Thread::~Input_Output_Thread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+std::future<void> Input_Output_Thread::operate(std::function<void(Input_Output_Unit&)> action)
+{
+    std::packaged_task<void()> task([this, action] { action(*m_unit); });
+    auto done = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_actions.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+    return done;
+}
+
+bool Input_Output_Thread::poll()
+{
+    check_unit();
+    bool resumed = false;
+    Message message;
+    while (m_signals.pop(message))
+    {
+        if (message.signal == Signal::resume_source)
+        {
+            m_source_buffer = message.buffer;
+            if (auto client = m_source_client.lock())
+                client->resume_source_client();
+        }
+        else if (auto client = m_sink_client.lock())
+            client->resume_sink_client();
+        resumed = true;
+    }
+    // Resumes that didn't fit in the queue come after the ones that did.
+    if (m_overflow_resume_source.exchange(false, std::memory_order_acquire))
+    {
+        m_source_buffer = m_overflow_source_buffer.load(std::memory_order_acquire);
+        if (auto client = m_source_client.lock())
+            client->resume_source_client();
+        resumed = true;
+    }
+    if (m_overflow_resume_sink.exchange(false, std::memory_order_acquire))
+    {
+        if (auto client = m_sink_client.lock())
+            client->resume_sink_client();
+        resumed = true;
+    }
+    return resumed;
+}
+
+void Input_Output_Thread::connect_source_client(std::weak_ptr<Source_Client> client)
+{
+    m_source_client = client;
+}
+
+void Input_Output_Thread::advance_source()
+{
+    send({Signal::advance_source});
+}
+
+const Buffer& Input_Output_Thread::get_source()
+{
+    static const Buffer empty;
+    return m_source_buffer ? *m_source_buffer : empty;
+}
+
+void Input_Output_Thread::connect_sink_client(std::weak_ptr<Sink_Client> client)
+{
+    m_sink_client = client;
+}
+
+void Input_Output_Thread::advance_sink()
+{
+    // Fill the other buffer while this one is punched.  The client waits to be resumed before
+    // filling again, so the unit is done with the other one.
+    send({Signal::advance_sink, &m_sink_buffers.back()});
+    m_sink_buffers.flip();
+    m_sink_buffers.back().clear();
+}
+
+Buffer& Input_Output_Thread::get_sink()
+{
+    return m_sink_buffers.back();
+}
+
+void Input_Output_Thread::send(Message message)
+{
+    check_unit();
+    // A client that waits to be resumed has at most one request of each kind in flight.
+    if (!m_requests.push(std::move(message)))
+        throw std::runtime_error("card unit request queue is full: a client advanced "
+                                 "without waiting to be resumed");
+    // Take the lock so the unit's thread can't miss the request between checking for
+    // requests and going to sleep.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_wake.notify_one();
+}
+
+void Input_Output_Thread::check_unit() const
+{
+    if (m_unit_failed.load(std::memory_order_acquire))
+        std::rethrow_exception(m_unit_error);
+}
+
+void Input_Output_Thread::signal(Message message)
+{
+    if (m_signals.push(message))
+        return;
+    // The clients haven't polled for a while, e.g. because the operator pressed read start
+    // again and again.  A resume only lets a client go on, so extra ones of the same kind
+    // can be merged.  Keep the latest to be delivered after the queued signals.
+    if (message.signal == Signal::resume_source)
+    {
+        m_overflow_source_buffer.store(message.buffer, std::memory_order_release);
+        m_overflow_resume_source.store(true, std::memory_order_release);
+    }
+    else
+        m_overflow_resume_sink.store(true, std::memory_order_release);
+}
+
+void Input_Output_Thread::run()
+{
+    while (true)
+    {
+        Message message;
+        while (m_requests.pop(message))
+        {
+            // The unit's state isn't known after it throws, so it's not used again.
+            if (m_unit_failed.load(std::memory_order_relaxed))
+                continue;
+            try
+            {
+                if (message.signal == Signal::advance_source)
+                    m_unit->advance_source();
+                else
+                {
+                    m_unit->get_sink() = *message.buffer;
+                    m_unit->advance_sink();
+                }
+            }
+            catch (...)
+            {
+                // An exception can't leave the thread.  The clients get it instead.
+                m_unit_error = std::current_exception();
+                m_unit_failed.store(true, std::memory_order_release);
+            }
+        }
+
+        std::deque<std::packaged_task<void()>> actions;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_actions.empty() && m_requests.empty())
+            {
+                if (m_stop)
+                    return;
+                m_wake.wait(lock, [this] {
+                    return m_stop || !m_actions.empty() || !m_requests.empty(); });
+            }
+            actions.swap(m_actions);
+        }
+        for (auto& action : actions)
+            action();
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef INPUT_OUTPUT_THREAD_HPP
+#define INPUT_OUTPUT_THREAD_HPP
+
+#include "input_output_unit.hpp"
+#include "ring_queue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace IBM533
+{
+/// Runs a type 533 unit on its own thread.  Clients connect to this object as if it were the
+/// unit.  Read and punch buffers are passed between the threads through lock-free queues, so
+/// a client never waits for the unit's work.  It only takes a lock briefly to wake the
+/// unit's thread, which sleeps while there's nothing to do.
+///
+/// The interlocks work as they do with the unit alone: after advance_source() or
+/// advance_sink() the client must wait for its resume call before using the buffer again.
+/// Resume calls are made from poll(), on the client's thread, never from the unit's thread.
+///
+/// If the unit throws while handling a request, e.g. because a spilling stacker's writer
+/// failed, the exception is passed to the clients' thread and rethrown by every later call
+/// to poll(), advance_source() or advance_sink().  Requests sent after that are dropped.
+class Input_Output_Thread : public Source, public Sink
+{
+public:
+    /// Start a thread for the passed-in unit.  The unit must not be used directly after this.
+    Input_Output_Thread(std::shared_ptr<Input_Output_Unit> unit);
+    /// Finish the pending requests and stop the thread.
+    ~Input_Output_Thread();
+
+    /// Run an operator action, such as loading a hopper or pressing a key, on the unit's
+    /// thread.  @Return a future that's ready when the action is done.
+    std::future<void> operate(std::function<void(Input_Output_Unit&)> action);
+
+    /// Deliver the unit's signals to continue.  Call from the clients' thread.  Never waits.
+    /// @Return true if a client was resumed.  Rethrows the unit's exception, if any.
+    bool poll();
+
+    // Source overrides
+
+    virtual void connect_source_client(std::weak_ptr<Source_Client> client) override;
+    virtual void advance_source() override;
+    virtual const Buffer& get_source() override;
+
+    // Sink overrides
+
+    virtual void connect_sink_client(std::weak_ptr<Sink_Client> client) override;
+    virtual void advance_sink() override;
+    virtual Buffer& get_sink() override;
+
+private:
+    /// Receives the unit's resume calls on the unit's thread.
+    class Unit_Client;
+
+    enum class Signal
+    {
+        advance_source,
+        advance_sink,
+        resume_source,
+        resume_sink,
+    };
+    struct Message
+    {
+        Signal signal;
+        /// The punched words for advance_sink, the read words for resume_source.  The buffer
+        /// is not copied.  The interlocks keep its owner from changing it until it's used.
+        const Buffer* buffer = nullptr;
+    };
+    /// The maximum number of messages in flight in each direction.  The interlocks allow
+    /// one request per feed.  Operator actions may resume the clients any number of times.
+    static constexpr std::size_t queue_size = 8;
+
+    void run();
+    /// Pass a request to the unit's thread.  Throws std::runtime_error if the queue is full,
+    /// which means a client didn't wait to be resumed.  Rethrows the unit's exception, if any.
+    void send(Message message);
+    /// Rethrow the exception the unit threw on its thread, if any.
+    void check_unit() const;
+    /// Pass a signal to the clients' thread.  Signals that don't fit are merged.
+    void signal(Message message);
+
+    std::shared_ptr<Input_Output_Unit> m_unit;
+    std::shared_ptr<Unit_Client> m_unit_client;
+
+    // Client side.  Used only on the clients' thread.
+    std::weak_ptr<Source_Client> m_source_client;
+    std::weak_ptr<Sink_Client> m_sink_client;
+    /// The unit's read buffer.  The unit double-buffers it, so it's not changed while the
+    /// next card is read.
+    const Buffer* m_source_buffer = nullptr;
+    /// The client fills the back buffer.  The front one is being punched.
+    Double_Buffer m_sink_buffers;
+
+    /// Requests from the clients to the unit.
+    Ring_Queue<Message, queue_size> m_requests;
+    /// Signals from the unit to the clients.
+    Ring_Queue<Message, queue_size> m_signals;
+    /// Resumes that didn't fit in m_signals, and the buffer for the latest source resume.
+    std::atomic<bool> m_overflow_resume_source = false;
+    std::atomic<bool> m_overflow_resume_sink = false;
+    std::atomic<const Buffer*> m_overflow_source_buffer = nullptr;
+    /// The exception thrown by the unit while handling a request.  Set on the unit's thread
+    /// before m_unit_failed, and not changed after.
+    std::exception_ptr m_unit_error;
+    std::atomic<bool> m_unit_failed = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::packaged_task<void()>> m_actions;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+}
+
+#endif
@@ -1,76 +1,280 @@
 #include "input_output_unit.hpp"
+#include "snapshot.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <iostream>
 
 using namespace IBM533;
 using namespace IBM650;
 
-using Card_Ptr_Deck = std::deque<std::shared_ptr<Card>>;
+namespace
+{
+// Snapshots store cards in their packed form.  Decks and buffers are preceded by their sizes.
+// Cards in the feeds are preceded by a byte that's 0 if the station is empty.
+const char snapshot_format[] = "I533";
+const std::uint16_t snapshot_version = 3;
 
-const std::size_t read_feed_size = 3;
-const std::size_t punch_feed_size = 2;
+void put_card(Snapshot::Writer& snapshot, const Packed_Card& card)
+{
+    snapshot.put(card.bytes());
+}
+
+Packed_Card get_card(Snapshot::Reader& snapshot)
+{
+    Packed_Card card;
+    card.bytes() = snapshot.get<Packed_Card::Bytes>();
+    return card;
+}
+
+template <typename Deck>
+void put_deck(Snapshot::Writer& snapshot, const Deck& deck)
+{
+    snapshot.put_count(deck.size());
+    for (const auto& card : deck)
+        put_card(snapshot, card);
+}
+
+Packed_Deck get_deck(Snapshot::Reader& snapshot)
+{
+    Packed_Deck deck(snapshot.get_count(Packed_Card::n_bytes));
+    for (auto& card : deck)
+        card = get_card(snapshot);
+    return deck;
+}
+
+Packed_Deck pack(const Card_Deck& deck)
+{
+    return Packed_Deck(deck.begin(), deck.end());
+}
+
+template <typename Deck>
+Card_Deck unpack(const Deck& deck)
+{
+    Card_Deck cards;
+    for (const auto& card : deck)
+        cards.push_back(card.unpack());
+    return cards;
+}
+
+template <std::size_t N>
+void put_feed(Snapshot::Writer& snapshot, const Card_Feed<N>& feed)
+{
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        auto card = feed.station(i);
+        snapshot.put(static_cast<std::uint8_t>(card != nullptr));
+        if (card)
+            put_card(snapshot, *card);
+    }
+}
+
+template <std::size_t N>
+Card_Feed<N> get_feed(Snapshot::Reader& snapshot)
+{
+    // Feed the stations in order.  The stacker gets nothing since the feed starts empty.
+    Card_Feed<N> feed;
+    Packed_Deck stacker;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        if (snapshot.get<std::uint8_t>())
+        {
+            auto card = get_card(snapshot);
+            feed.advance(&card, stacker);
+        }
+        else
+            feed.advance(nullptr, stacker);
+    }
+    assert(stacker.empty());
+    return feed;
+}
+
+void put_buffer(Snapshot::Writer& snapshot, const Buffer& buffer)
+{
+    snapshot.put_count(buffer.size());
+    for (const auto& word : buffer)
+        snapshot.put_bytes(word.digits().data(), word_size + 1);
+}
+
+Buffer get_buffer(Snapshot::Reader& snapshot)
+{
+    auto size = snapshot.get_count(word_size + 1);
+    if (size > Buffer::capacity)
+        throw std::runtime_error("snapshot buffer is too big");
+    Buffer buffer(size);
+    for (auto& word : buffer)
+    {
+        auto codes = snapshot.get_bytes(word_size + 1);
+        std::copy(codes, codes + word_size + 1, word.digits().begin());
+    }
+    return buffer;
+}
+}
+
+Packed_Card::Packed_Card(const Card& card)
+    : m_bytes{}
+{
+    for (std::size_t i = 0; i < card_columns; ++i)
+        set_column(i, card[i]);
+}
+
+Card Packed_Card::unpack() const
+{
+    Card card;
+    for (std::size_t i = 0; i < card_columns; ++i)
+        card[i] = column(i);
+    return card;
+}
 
 Buffer IBM533::card_to_buffer(const Card& card)
 {
-    auto digit = [](std::size_t n) {
-        TDigit i;
-        for (i = 0; !(n & 1) && i < 10; ++i, n = n >> 1)
-            ;
-        return i;
-    };
+    return card_to_buffer(Packed_Card(card));
+}
+
+Buffer IBM533::card_to_buffer(const Packed_Card& card)
+{
+    Buffer buffer;
+    card_to_buffer(card, buffer);
+    return buffer;
+}
+
+namespace
+{
+constexpr int digit_rows = 0x3ff;
+constexpr int row_11 = 0x400;
+constexpr int row_12 = 0x800;
+/// The code that bin() gives for something that's not a digit.
+constexpr TDigit not_a_code = 0x7f;
+
+/// @Return a table of the bi-quinary code for each pattern of digit punches in a column.
+/// With more than one punch the lowest digit is taken.  A blank column gives a code that's
+/// not a digit.
+constexpr std::array<TDigit, digit_rows + 1> make_punch_codes()
+{
+    std::array<TDigit, digit_rows + 1> codes{};
+    codes[0] = not_a_code;
+    for (int punches = 1; punches <= digit_rows; ++punches)
+    {
+        int digit = 0;
+        while (!(punches >> digit & 1))
+            ++digit;
+        codes[punches] = bi_quinary_code[digit];
+    }
+    return codes;
+}
+
+/// @Return a table of the digit punch for each 7-bit code.  Codes that aren't digits give a
+/// blank column.
+constexpr std::array<int, 0x80> make_code_punches()
+{
+    std::array<int, 0x80> punches{};
+    for (int digit = 0; digit < base; ++digit)
+        punches[bi_quinary_code[digit]] = 1 << digit;
+    return punches;
+}
+
+constexpr auto punch_codes = make_punch_codes();
+constexpr auto code_punches = make_code_punches();
+}
+
+void IBM533::card_to_buffer(const Packed_Card& card, Buffer& buffer)
+{
+    Card_Check check;
+    card_to_buffer(card, buffer, check);
+}
 
-    Buffer buffer(buffer_size);
-    for (std::size_t i = 0; i < card.size()/word_size; ++i)
+bool IBM533::card_to_buffer(const Packed_Card& card, Buffer& buffer, Card_Check& check)
+{
+    // Each 3 bytes hold 2 columns.  A word's 10 columns are 15 bytes.
+    constexpr std::size_t word_bytes = word_size*3/2;
+    check = Card_Check();
+    buffer.resize(buffer_size);
+    auto bytes = card.bytes().data();
+    for (std::size_t i = 0; i < card_words; ++i, bytes += word_bytes)
     {
-        std::array<TDigit, word_size+1> digits;
-        std::size_t n = i*word_size;
-        for (std::size_t j = 0; j < word_size; ++j, ++n)
-            digits[j] = digit(card[n]);
-        digits[word_size] = (card[n-1] & 0x400) ? '-' : '+';
-        buffer[i] = Word(digits);
+        auto& digits = buffer[i].digits();
+        // Bit j is set for column j of the word.
+        unsigned long blank = 0;
+        unsigned long multiple = 0;
+        int column = 0;
+        for (std::size_t j = 0; j < word_size; ++j)
+        {
+            auto byte = bytes + j*3/2;
+            column = j % 2 == 0 ? byte[0] | (byte[1] & 0x0f) << 8 : byte[0] >> 4 | byte[1] << 4;
+            auto rows = column & digit_rows;
+            digits[j] = punch_codes[rows];
+            blank |= static_cast<unsigned long>(rows == 0) << j;
+            multiple |= static_cast<unsigned long>((rows & (rows - 1)) != 0) << j;
+        }
+        // The sign is in the units column.
+        digits[word_size] = bi_quinary_code[column & row_11 ? 8 : 9];
+        if (blank | multiple)
+        {
+            check.blank |= std::bitset<card_columns>(blank) << i*word_size;
+            check.multiple |= std::bitset<card_columns>(multiple) << i*word_size;
+        }
     }
     buffer[8] = zero;
     buffer[9] = zero;
-    return buffer;
+    return check.is_valid();
 }
 
-/// @Return a card punched with the first 8 words of the buffer.
-Card buffer_to_card(const Buffer& buffer)
+Card IBM533::buffer_to_card(const Buffer& buffer)
 {
-    Card card;
-    for (std::size_t i = 0; i < card.size()/word_size; ++i)
+    return buffer_to_packed_card(buffer).unpack();
+}
+
+Packed_Card IBM533::buffer_to_packed_card(const Buffer& buffer)
+{
+    assert(buffer.size() >= card_words);
+    Packed_Card card;
+    auto bytes = card.bytes().data();
+    for (std::size_t i = 0; i < card_words; ++i)
     {
-        assert(i < buffer.size());
-        std::size_t n = i*word_size;
-        for (std::size_t j = 0; j < word_size; ++j, ++n)
+        const auto& digits = buffer[i].digits();
+        for (std::size_t j = 0; j < word_size; j += 2, bytes += 3)
         {
-            assert(n < card_columns);
-            card[n] = 1 << dec(buffer[i].digits()[j]);
+            int even = code_punches[digits[j] & 0x7f];
+            int odd = code_punches[digits[j + 1] & 0x7f];
+            if (j + 2 == word_size)
+                odd |= digits[word_size] == bi_quinary_code[9] ? row_12 : row_11;
+            bytes[0] = even & 0xff;
+            bytes[1] = (even >> 8) | (odd & 0x0f) << 4;
+            bytes[2] = odd >> 4;
         }
-        card[n - 1] |= 1 << (buffer[i].sign() == '+' ? 11 : 10);
     }
     return card;
 }
 
-void advance(Card_Deck& hopper, Card_Ptr_Deck& fed, Card_Deck& stacker)
+namespace
 {
-    // Feed a card from the stack into the device.
-    fed.push_back(hopper.empty() ? nullptr : std::make_shared<Card>(hopper.front()));
-
-    // If a card was pushed past the last station, move it to the stack.
-    if (fed.front())
-        stacker.push_back(*(fed.front()));
-    fed.pop_front();
+template <std::size_t N>
+void advance(Card_Hopper& hopper, Card_Feed<N>& fed, Card_Stacker& stacker)
+{
+    // Feed a card from the hopper into the device.  If a card is pushed past the last
+    // station, it goes to the stacker.
+    fed.advance(hopper.empty() ? nullptr : &hopper.front(), stacker);
 
     // Remove the card from the hopper.
     if (!hopper.empty())
         hopper.pop_front();
 }
 
+void spill(Card_Stacker& stacker, const Card_Writer& writer, std::size_t window)
+{
+    if (!writer)
+        return;
+    if (stacker.size() <= window)
+        return;
+    auto n = stacker.size() - window;
+    auto end = stacker.begin() + n;
+    for (auto it = stacker.begin(); it != end; ++it)
+        writer(it->unpack());
+    stacker.pop_front(n);
+}
+}
+
 Input_Output_Unit::Input_Output_Unit()
-    : m_fed_read_cards(read_feed_size),
-      m_fed_punch_cards(punch_feed_size)
 {
 }
 
@@ -89,24 +293,57 @@ bool Input_Output_Unit::is_end_of_file() const
     return m_end_of_file;
 }
 
+bool Input_Output_Unit::is_read_hopper_streamed() const
+{
+    return m_read_hopper_streamed;
+}
+
+bool Input_Output_Unit::is_double_punch_or_blank() const
+{
+    return m_double_punch_or_blank;
+}
+
 void Input_Output_Unit::load_read_hopper(const Card_Deck& deck)
 {
-    m_read_hopper_deck = deck;
+    m_read_hopper_deck = Card_Hopper(pack(deck));
+    m_read_hopper_reader = nullptr;
+    m_read_hopper_streamed = false;
+}
+
+void Input_Output_Unit::load_read_hopper(Card_Reader reader)
+{
+    m_read_hopper_deck.clear();
+    m_read_hopper_reader = std::move(reader);
+    m_read_hopper_streamed = true;
+    fill_read_hopper();
+}
+
+void Input_Output_Unit::fill_read_hopper()
+{
+    // Keep a full feed's worth so read start sees as many cards as it would with a deck.
+    Card card;
+    while (m_read_hopper_reader && m_read_hopper_deck.size() < read_feed_size)
+    {
+        if (m_read_hopper_reader(card))
+            m_read_hopper_deck.push_back(Packed_Card(card));
+        else
+            m_read_hopper_reader = nullptr;
+    }
 }
 
 void Input_Output_Unit::load_punch_hopper(const Card_Deck& deck)
 {
-    m_punch_hopper_deck = deck;
+    m_punch_hopper_deck = Card_Hopper(pack(deck));
 }
 
 void Input_Output_Unit::read_start()
 {
     m_read_running = true;
+    m_double_punch_or_blank = false;
 
     std::size_t n_cards = m_pending_read_advance ? 1
         : !m_read_hopper_deck.empty()
-        && std::all_of(m_fed_read_cards.begin(), m_fed_read_cards.end(),
-                       [](auto p) { return p; })
+        && m_fed_read_cards.is_full()
         ? 0
         : std::min(std::max(m_read_hopper_deck.size(), static_cast<std::size_t>(1)),
                    static_cast<std::size_t>(read_feed_size));
@@ -115,10 +352,10 @@ void Input_Output_Unit::read_start()
     for (std::size_t i = 0; i < n_cards; ++i)
         advance_read_cards();
 
-    assert(m_fed_read_cards.size() == read_feed_size);
-
+    // The program can't read until a card gets to the read station.
     if (auto client = m_source_client.lock())
-        client->resume_source_client();
+        if (m_fed_read_cards.front())
+            client->resume_source_client();
 }
 
 void Input_Output_Unit::punch_start()
@@ -127,6 +364,8 @@ void Input_Output_Unit::punch_start()
     {
         // Run out one card.
         advance(m_punch_hopper_deck, m_fed_punch_cards, m_punch_stacker_deck);
+        spill_stackers();
+        flush_stackers();
         return;
     }
 
@@ -138,7 +377,10 @@ void Input_Output_Unit::punch_start()
         advance(m_punch_hopper_deck, m_fed_punch_cards, m_punch_stacker_deck);
         m_pending_punch_advance = false;
     }
+    spill_stackers();
     m_punch_running = !m_punch_hopper_deck.empty();
+    if (!m_punch_running)
+        flush_stackers();
     if (auto client = m_sink_client.lock())
         if (m_punch_running)
             client->resume_sink_client();
@@ -148,12 +390,14 @@ void Input_Output_Unit::read_stop()
 {
     m_read_running = false;
     m_punch_running = false;
+    flush_stackers();
 }
 
 void Input_Output_Unit::punch_stop()
 {
     m_read_running = false;
     m_punch_running = false;
+    flush_stackers();
 }
 
 void Input_Output_Unit::end_of_file()
@@ -162,24 +406,113 @@ void Input_Output_Unit::end_of_file()
     advance_source();
 }
 
-const Card_Deck& Input_Output_Unit::read_hopper_deck() const
+void Input_Output_Unit::save_state(std::ostream& os) const
+{
+    Snapshot::Writer snapshot;
+    put_deck(snapshot, m_read_hopper_deck);
+    put_deck(snapshot, m_read_stacker_deck);
+    put_deck(snapshot, m_punch_hopper_deck);
+    put_deck(snapshot, m_punch_stacker_deck);
+    put_feed(snapshot, m_fed_read_cards);
+    put_feed(snapshot, m_fed_punch_cards);
+    snapshot.put(static_cast<std::uint8_t>(m_read_running));
+    snapshot.put(static_cast<std::uint8_t>(m_punch_running));
+    snapshot.put(static_cast<std::uint8_t>(m_pending_read_advance));
+    snapshot.put(static_cast<std::uint8_t>(m_pending_punch_advance));
+    snapshot.put(static_cast<std::uint8_t>(m_end_of_file));
+    snapshot.put(static_cast<std::uint8_t>(m_double_punch_or_blank));
+    put_buffer(snapshot, m_source_buffers.front());
+    put_buffer(snapshot, m_sink_buffer);
+    snapshot.write(os, snapshot_format, snapshot_version);
+}
+
+void Input_Output_Unit::load_state(std::istream& is)
+{
+    Snapshot::Reader snapshot(is, snapshot_format, snapshot_version);
+    auto read_hopper_deck = Card_Hopper(get_deck(snapshot));
+    auto read_stacker_deck = Card_Stacker(get_deck(snapshot));
+    auto punch_hopper_deck = Card_Hopper(get_deck(snapshot));
+    auto punch_stacker_deck = Card_Stacker(get_deck(snapshot));
+    auto fed_read_cards = get_feed<read_feed_size>(snapshot);
+    auto fed_punch_cards = get_feed<punch_feed_size>(snapshot);
+    auto read_running = snapshot.get<std::uint8_t>() != 0;
+    auto punch_running = snapshot.get<std::uint8_t>() != 0;
+    auto pending_read_advance = snapshot.get<std::uint8_t>() != 0;
+    auto pending_punch_advance = snapshot.get<std::uint8_t>() != 0;
+    auto end_of_file = snapshot.get<std::uint8_t>() != 0;
+    auto double_punch_or_blank = snapshot.get<std::uint8_t>() != 0;
+    auto source_buffer = get_buffer(snapshot);
+    auto sink_buffer = get_buffer(snapshot);
+    snapshot.finish();
+
+    m_read_hopper_deck = std::move(read_hopper_deck);
+    m_read_hopper_reader = nullptr;
+    m_read_hopper_streamed = false;
+    m_read_stacker_deck = std::move(read_stacker_deck);
+    m_punch_hopper_deck = std::move(punch_hopper_deck);
+    m_punch_stacker_deck = std::move(punch_stacker_deck);
+    m_fed_read_cards = std::move(fed_read_cards);
+    m_fed_punch_cards = std::move(fed_punch_cards);
+    m_read_running = read_running;
+    m_punch_running = punch_running;
+    m_pending_read_advance = pending_read_advance;
+    m_pending_punch_advance = pending_punch_advance;
+    m_end_of_file = end_of_file;
+    m_double_punch_or_blank = double_punch_or_blank;
+    m_source_buffers.front() = source_buffer;
+    m_sink_buffer = sink_buffer;
+}
+
+Card_Deck Input_Output_Unit::read_hopper_deck() const
+{
+    return unpack(m_read_hopper_deck);
+}
+
+Card_Deck Input_Output_Unit::read_stacker_deck() const
+{
+    return unpack(m_read_stacker_deck);
+}
+
+Card_Deck Input_Output_Unit::punch_hopper_deck() const
+{
+    return unpack(m_punch_hopper_deck);
+}
+
+Card_Deck Input_Output_Unit::punch_stacker_deck() const
 {
-    return m_read_hopper_deck;
+    return unpack(m_punch_stacker_deck);
 }
 
-const Card_Deck& Input_Output_Unit::read_stacker_deck() const
+void Input_Output_Unit::spill_read_stacker(Card_Writer writer, std::size_t window,
+                                            Card_Flush flush)
 {
-    return m_read_stacker_deck;
+    m_read_stacker_writer = std::move(writer);
+    m_read_stacker_window = window;
+    m_read_stacker_flush = std::move(flush);
+    spill_stackers();
 }
 
-const Card_Deck& Input_Output_Unit::punch_hopper_deck() const
+void Input_Output_Unit::spill_punch_stacker(Card_Writer writer, std::size_t window,
+                                             Card_Flush flush)
 {
-    return m_punch_hopper_deck;
+    m_punch_stacker_writer = std::move(writer);
+    m_punch_stacker_window = window;
+    m_punch_stacker_flush = std::move(flush);
+    spill_stackers();
 }
 
-const Card_Deck& Input_Output_Unit::punch_stacker_deck() const
+void Input_Output_Unit::spill_stackers()
 {
-    return m_punch_stacker_deck;
+    spill(m_read_stacker_deck, m_read_stacker_writer, m_read_stacker_window);
+    spill(m_punch_stacker_deck, m_punch_stacker_writer, m_punch_stacker_window);
+}
+
+void Input_Output_Unit::flush_stackers()
+{
+    if (m_read_stacker_flush)
+        m_read_stacker_flush();
+    if (m_punch_stacker_flush)
+        m_punch_stacker_flush();
 }
 
 void Input_Output_Unit::connect_source_client(std::weak_ptr<Source_Client> client)
@@ -190,10 +523,18 @@ void Input_Output_Unit::connect_source_client(std::weak_ptr<Source_Client> clien
 void Input_Output_Unit::advance_read_cards()
 {
     advance(m_read_hopper_deck, m_fed_read_cards, m_read_stacker_deck);
+    fill_read_hopper();
+    spill_stackers();
 
     // If a card was pushed into the 3rd station, read it into the buffer.
     if (m_fed_read_cards.front())
-        m_source_buffer = card_to_buffer(*m_fed_read_cards.front());
+    {
+        Card_Check check;
+        // Decode into the back buffer so the client's buffer isn't changed until the flip.
+        if (!card_to_buffer(*m_fed_read_cards.front(), m_source_buffers.back(), check))
+            m_double_punch_or_blank = true;
+        m_source_buffers.flip();
+    }
 
     m_pending_read_advance = false;
 }
@@ -201,7 +542,7 @@ void Input_Output_Unit::advance_read_cards()
 void Input_Output_Unit::advance_source()
 {
     // No more cards inside.
-    if (std::all_of(m_fed_read_cards.begin(), m_fed_read_cards.end(), [](auto p) { return !p; }))
+    if (m_fed_read_cards.is_empty())
         m_end_of_file = false;
 
     m_pending_read_advance = true;
@@ -209,13 +550,22 @@ void Input_Output_Unit::advance_source()
         return;
 
     advance_read_cards();
+    // After the last card is stacked there's nothing more to read.
     if (auto client = m_source_client.lock())
-        client->resume_source_client();
+        if (m_fed_read_cards.front())
+            client->resume_source_client();
+}
+
+const Buffer& Input_Output_Unit::get_source()
+{
+    return m_source_buffers.front();
 }
 
-Buffer& Input_Output_Unit::get_source()
+Card_Hold Input_Output_Unit::source_hold() const
 {
-    return m_source_buffer;
+    if (!m_read_running)
+        return Card_Hold::stopped;
+    return m_fed_read_cards.is_empty() ? Card_Hold::hopper_empty : Card_Hold::end_of_file;
 }
 
 void Input_Output_Unit::connect_sink_client(std::weak_ptr<Sink_Client> client)
@@ -231,7 +581,10 @@ void Input_Output_Unit::advance_sink()
 
     punch();
     advance(m_punch_hopper_deck, m_fed_punch_cards, m_punch_stacker_deck);
+    spill_stackers();
     m_punch_running = !m_punch_hopper_deck.empty();
+    if (!m_punch_running)
+        flush_stackers();
     if (auto client = m_sink_client.lock())
         if (m_punch_running)
             client->resume_sink_client();
@@ -239,7 +592,7 @@ void Input_Output_Unit::advance_sink()
 
 void Input_Output_Unit::punch()
 {
-    *m_fed_punch_cards.front() = buffer_to_card(m_sink_buffer);
+    *m_fed_punch_cards.front() = buffer_to_packed_card(m_sink_buffer);
     m_sink_buffer.clear();
 }
 
@@ -247,3 +600,8 @@ Buffer& Input_Output_Unit::get_sink()
 {
     return m_sink_buffer;
 }
+
+Card_Hold Input_Output_Unit::sink_hold() const
+{
+    return m_punch_hopper_deck.empty() ? Card_Hold::hopper_empty : Card_Hold::stopped;
+}
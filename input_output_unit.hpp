@@ -1,24 +1,263 @@
+#ifndef INPUT_OUTPUT_UNIT_HPP
+#define INPUT_OUTPUT_UNIT_HPP
+
 #include "buffer.hpp"
 
+#include <algorithm>
 #include <array>
+#include <bitset>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <iosfwd>
 #include <memory>
+#include <vector>
 
 namespace IBM533
 {
 constexpr std::size_t buffer_size = 10;
 constexpr std::size_t card_words = 8;
 constexpr std::size_t card_columns = IBM650::word_size*card_words;
+/// A card as a column of punches per int.  Bit 11 is row 12, bit 10 is row 11, and bits 0 to
+/// 9 are rows 0 to 9.
 using Card = std::array<int, card_columns>;
 using Card_Deck = std::deque<Card>;
 
+/// A card with its 12 rows of punches packed into 12 bits per column, 120 bytes in all.
+/// Pairs of columns share 3 bytes: the low byte of the even column, its high nibble under
+/// the odd column's low nibble, then the high byte of the odd column.  Bits beyond the 12
+/// rows are dropped.
+class Packed_Card
+{
+public:
+    static constexpr std::size_t n_bytes = card_columns*12/8;
+    using Bytes = std::array<std::uint8_t, n_bytes>;
+
+    /// Make a blank card.
+    Packed_Card() : m_bytes{} {}
+    explicit Packed_Card(const Card& card);
+    /// @Return the card with a column per int.
+    Card unpack() const;
+
+    /// @Return the punches in a column.
+    int column(std::size_t n) const;
+    void set_column(std::size_t n, int punches);
+
+    const Bytes& bytes() const { return m_bytes; }
+    Bytes& bytes() { return m_bytes; }
+
+    bool operator==(const Packed_Card& card) const { return m_bytes == card.m_bytes; }
+    bool operator!=(const Packed_Card& card) const { return m_bytes != card.m_bytes; }
+
+private:
+    Bytes m_bytes;
+};
+using Packed_Deck = std::vector<Packed_Card>;
+
+/// A deck in a hopper.  Cards are taken from the front by moving past them, so feeding
+/// doesn't free cards or move the rest of the deck.
+class Card_Hopper
+{
+public:
+    Card_Hopper() = default;
+    explicit Card_Hopper(Packed_Deck deck) : m_cards(std::move(deck)) {}
+
+    bool empty() const { return m_next == m_cards.size(); }
+    std::size_t size() const { return m_cards.size() - m_next; }
+    const Packed_Card& front() const { return m_cards[m_next]; }
+    Packed_Deck::const_iterator begin() const { return m_cards.begin() + m_next; }
+    Packed_Deck::const_iterator end() const { return m_cards.end(); }
+
+    void pop_front() { ++m_next; }
+    /// Add a card to the back.  Cards already taken are dropped first so that a hopper
+    /// that's topped up as it's fed keeps reusing its storage.
+    void push_back(const Packed_Card& card);
+    void clear();
+
+private:
+    Packed_Deck m_cards;
+    /// The index of the card at the front.
+    std::size_t m_next = 0;
+};
+
+inline void Card_Hopper::push_back(const Packed_Card& card)
+{
+    m_cards.erase(m_cards.begin(), m_cards.begin() + m_next);
+    m_next = 0;
+    m_cards.push_back(card);
+}
+
+inline void Card_Hopper::clear()
+{
+    m_cards.clear();
+    m_next = 0;
+}
+
+/// The cards in a stacker.  A spilling stacker takes cards off the bottom, the ones stacked
+/// first.  Their storage is reclaimed in batches, so a card costs the same however many
+/// cards are kept.
+class Card_Stacker
+{
+public:
+    Card_Stacker() = default;
+    explicit Card_Stacker(Packed_Deck deck) : m_cards(std::move(deck)) {}
+
+    bool empty() const { return m_first == m_cards.size(); }
+    std::size_t size() const { return m_cards.size() - m_first; }
+    Packed_Deck::const_iterator begin() const { return m_cards.begin() + m_first; }
+    Packed_Deck::const_iterator end() const { return m_cards.end(); }
+
+    void push_back(const Packed_Card& card) { m_cards.push_back(card); }
+    /// Remove n cards from the bottom.
+    void pop_front(std::size_t n);
+
+private:
+    Packed_Deck m_cards;
+    /// The index of the card at the bottom.
+    std::size_t m_first = 0;
+};
+
+inline void Card_Stacker::pop_front(std::size_t n)
+{
+    m_first += n;
+    // Drop the removed cards when they're at least half of the storage.  The cards that are
+    // kept are moved at most once for each time as many cards are removed.
+    if (m_first >= m_cards.size() - m_first)
+    {
+        m_cards.erase(m_cards.begin(), m_cards.begin() + m_first);
+        m_first = 0;
+    }
+}
+
+/// The stations of a feed.  The cards are held in a fixed ring so that moving them through
+/// the feed doesn't allocate.
+template <std::size_t N> class Card_Feed
+{
+public:
+    /// @Return the card at a station, or nullptr if the station is empty.  Station 0 is the
+    /// last one, the card that was fed first.
+    Packed_Card* station(std::size_t n);
+    const Packed_Card* station(std::size_t n) const;
+    Packed_Card* front() { return station(0); }
+    const Packed_Card* front() const { return station(0); }
+    /// @Return true if there's a card at every station.
+    bool is_full() const;
+    /// @Return true if there are no cards in the feed.
+    bool is_empty() const;
+
+    /// Move the cards along a station.  The card at the last station, if any, goes on the
+    /// back of the stacker.  A copy of the passed-in card, if any, goes into the first
+    /// station.
+    template <typename Stacker> void advance(const Packed_Card* card, Stacker& stacker);
+
+private:
+    std::size_t index(std::size_t n) const { return (m_last + n) % N; }
+
+    std::array<Packed_Card, N> m_cards;
+    std::array<bool, N> m_loaded{};
+    /// The index of the last station.
+    std::size_t m_last = 0;
+};
+
+template <std::size_t N>
+Packed_Card* Card_Feed<N>::station(std::size_t n)
+{
+    return m_loaded[index(n)] ? &m_cards[index(n)] : nullptr;
+}
+
+template <std::size_t N>
+const Packed_Card* Card_Feed<N>::station(std::size_t n) const
+{
+    return m_loaded[index(n)] ? &m_cards[index(n)] : nullptr;
+}
+
+template <std::size_t N>
+bool Card_Feed<N>::is_full() const
+{
+    return std::all_of(m_loaded.begin(), m_loaded.end(), [](bool loaded) { return loaded; });
+}
+
+template <std::size_t N>
+bool Card_Feed<N>::is_empty() const
+{
+    return std::none_of(m_loaded.begin(), m_loaded.end(), [](bool loaded) { return loaded; });
+}
+
+template <std::size_t N>
+template <typename Stacker>
+void Card_Feed<N>::advance(const Packed_Card* card, Stacker& stacker)
+{
+    // The last station's slot becomes the first station.
+    if (m_loaded[m_last])
+        stacker.push_back(m_cards[m_last]);
+    m_loaded[m_last] = card != nullptr;
+    if (card)
+        m_cards[m_last] = *card;
+    m_last = (m_last + 1) % N;
+}
+
+inline int Packed_Card::column(std::size_t n) const
+{
+    auto byte = m_bytes.data() + n/2*3;
+    return n % 2 == 0 ? byte[0] | (byte[1] & 0x0f) << 8 : byte[1] >> 4 | byte[2] << 4;
+}
+
+inline void Packed_Card::set_column(std::size_t n, int punches)
+{
+    auto byte = m_bytes.data() + n/2*3;
+    if (n % 2 == 0)
+    {
+        byte[0] = punches & 0xff;
+        byte[1] = (byte[1] & 0xf0) | (punches >> 8 & 0x0f);
+    }
+    else
+    {
+        byte[1] = (byte[1] & 0x0f) | (punches & 0x0f) << 4;
+        byte[2] = punches >> 4 & 0xff;
+    }
+}
+/// A function that sets its argument to the next card from some source.  @Return false when
+/// there are no more cards.
+using Card_Reader = std::function<bool(Card&)>;
+/// A function that takes cards in order.
+using Card_Writer = std::function<void(const Card&)>;
+/// A function that makes sure the cards passed to a writer have been stored.
+using Card_Flush = std::function<void()>;
+
+/// The columns of a card that can't be read as digits.  Bit n is column n.
+struct Card_Check
+{
+    /// Columns with no digit punch.
+    std::bitset<card_columns> blank;
+    /// Columns with more than one digit punch.
+    std::bitset<card_columns> multiple;
+
+    /// @Return true if every column has exactly one digit punch.
+    bool is_valid() const { return blank.none() && multiple.none(); }
+};
+
+/// @Return a buffer with the 8 words punched on the card followed by 2 zero words.  A blank
+/// column decodes to a code that's not a digit.  With more than one punch in a column, the
+/// lowest digit is taken.  A word is negative if its units column has an 11 punch.
 Buffer card_to_buffer(const Card& card);
+Buffer card_to_buffer(const Packed_Card& card);
+/// Decode a card into an existing buffer.  Reusing a buffer of the right size doesn't
+/// allocate.
+void card_to_buffer(const Packed_Card& card, Buffer& buffer);
+/// Decode a card and find the columns that don't have exactly one digit punch.  @Return
+/// true if there are none.
+bool card_to_buffer(const Packed_Card& card, Buffer& buffer, Card_Check& check);
+/// @Return a card punched with the first 8 words of the buffer.  Digits that aren't numbers
+/// leave their columns blank.
+Card buffer_to_card(const Buffer& buffer);
+Packed_Card buffer_to_packed_card(const Buffer& buffer);
 
 class Input_Output_Unit : public Source, public Sink
 {
-    using Card_Ptr_Deck = std::deque<std::shared_ptr<Card>>;
-
 public:
+    static constexpr std::size_t read_feed_size = 3;
+    static constexpr std::size_t punch_feed_size = 2;
+
     Input_Output_Unit();
 
     /// @Return true if the power light is on.  The unit has a physical power switch, so as far
@@ -35,15 +274,39 @@ public:
     bool is_end_of_file() const;
     /// @Return true if the read feed is jammed.  Always false.
     bool is_read_feed_stopped() const { return false; }
-    /// @Return true if a double punch or blank column was detected.  Always false.
-    bool is_double_punch_or_blank() const { return false; }
+    /// @Return true if a card was read with a column that has no digit punch or more than
+    /// one.  The light stays on until read-start is pressed.  Reading doesn't stop.
+    bool is_double_punch_or_blank() const;
 
-    const Card_Deck& read_hopper_deck() const;
-    const Card_Deck& read_stacker_deck() const;
-    const Card_Deck& punch_hopper_deck() const;
-    const Card_Deck& punch_stacker_deck() const;
+    /// @Return true if the read hopper was last loaded from a Card_Reader.  Stays true after
+    /// the reader runs out.  A restored unit's hopper isn't streamed.
+    bool is_read_hopper_streamed() const;
+
+    /// @Return a copy of the cards in the read hopper.  If the hopper was loaded from a
+    /// reader, only the few cards that have been pulled so far.
+    Card_Deck read_hopper_deck() const;
+    /// @Return a copy of the cards in the read stacker.  If it spills, only the last cards.
+    Card_Deck read_stacker_deck() const;
+    Card_Deck punch_hopper_deck() const;
+    /// @Return a copy of the cards in the punch stacker.  If it spills, only the last cards.
+    Card_Deck punch_stacker_deck() const;
+
+    /// Keep only the last window cards in the read stacker.  Older cards, including any
+    /// already there, are passed to the writer in the order they were stacked.  Pass an
+    /// empty writer to keep all cards again.  If there's a flush, it's called when the unit
+    /// stops: at read-stop or punch-stop, and when the punch hopper runs out.
+    void spill_read_stacker(Card_Writer writer, std::size_t window = 0,
+                            Card_Flush flush = nullptr);
+    /// Keep only the last window cards in the punch stacker, like spill_read_stacker().  With
+    /// a window of 0, each card is passed on as soon as it's punched and stacked.
+    void spill_punch_stacker(Card_Writer writer, std::size_t window = 0,
+                             Card_Flush flush = nullptr);
 
     void load_read_hopper(const Card_Deck& deck);
+    /// Load the read hopper with cards that are pulled from the reader as they're needed.
+    /// Only enough cards to fill the feed are held in the hopper at a time, so memory use
+    /// doesn't depend on the size of the deck.  Snapshots hold only the pulled cards.
+    void load_read_hopper(Card_Reader reader);
     void load_punch_hopper(const Card_Deck& deck);
     void read_start();
     void punch_start();
@@ -54,36 +317,69 @@ public:
     /// "end of file" lets the program continue and process the cards that are in the reader.
     void end_of_file();
 
+    /// Write the state of the unit to the passed-in stream in a versioned binary form: the
+    /// decks in the hoppers, feeds and stackers, the key states, and the buffers.  See
+    /// snapshot.hpp for the format.
+    void save_state(std::ostream& os) const;
+    /// Restore the state written by save_state().  Connections to clients and stacker spills
+    /// are not changed.
+    /// Throws std::runtime_error if the snapshot is not a card unit snapshot of the current
+    /// version, or if it's incomplete.  The unit is unchanged if an exception is thrown.
+    void load_state(std::istream& is);
+
     // Source overrides
 
     virtual void connect_source_client(std::weak_ptr<Source_Client> client) override;
     virtual void advance_source() override;
-    virtual Buffer& get_source() override;
+    virtual const Buffer& get_source() override;
+    virtual Card_Hold source_hold() const override;
 
     // Sink overrides
 
     virtual void connect_sink_client(std::weak_ptr<Sink_Client> client) override;
     virtual void advance_sink() override;
     virtual Buffer& get_sink() override;
+    virtual Card_Hold sink_hold() const override;
 
 private:
     void advance_read_cards();
+    /// Pull cards from the hopper's reader, if any, until there are enough to fill the feed.
+    void fill_read_hopper();
+    /// Pass cards beyond the windows of spilling stackers to their writers.
+    void spill_stackers();
+    /// Call the flushes of spilling stackers.
+    void flush_stackers();
     void punch();
-    Card_Deck m_read_hopper_deck;
-    Card_Deck m_read_stacker_deck;
-    Card_Deck m_punch_hopper_deck;
-    Card_Deck m_punch_stacker_deck;
-    Card_Ptr_Deck m_fed_read_cards;
-    Card_Ptr_Deck m_fed_punch_cards;
+    /// Cards are held packed.  They're converted at the unit's interface.
+    Card_Hopper m_read_hopper_deck;
+    /// Where more read hopper cards come from.  Empty if there are no more.
+    Card_Reader m_read_hopper_reader;
+    bool m_read_hopper_streamed = false;
+    Card_Stacker m_read_stacker_deck;
+    Card_Hopper m_punch_hopper_deck;
+    Card_Stacker m_punch_stacker_deck;
+    /// Where cards that don't fit in the stacker windows go.  Empty if the stacker keeps all
+    /// cards.
+    Card_Writer m_read_stacker_writer;
+    Card_Writer m_punch_stacker_writer;
+    std::size_t m_read_stacker_window = 0;
+    std::size_t m_punch_stacker_window = 0;
+    Card_Flush m_read_stacker_flush;
+    Card_Flush m_punch_stacker_flush;
+    Card_Feed<read_feed_size> m_fed_read_cards;
+    Card_Feed<punch_feed_size> m_fed_punch_cards;
     bool m_read_running = false;
     bool m_punch_running = false;
     bool m_pending_read_advance = false;
     bool m_pending_punch_advance = false;
     bool m_end_of_file = false;
+    bool m_double_punch_or_blank = false;
 
     std::weak_ptr<Source_Client> m_source_client;
     std::weak_ptr<Sink_Client> m_sink_client;
-    Buffer m_source_buffer;
+    Double_Buffer m_source_buffers;
     Buffer m_sink_buffer;
 };
 }
+
+#endif
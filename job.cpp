@@ -0,0 +1,548 @@
+#include "job.hpp"
+#include "result_cache.hpp"
+#include "text_deck.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace IBM650;
+using namespace IBM533;
+
+namespace
+{
+Address to_address(std::size_t n)
+{
+    return Address({TDigit(n/1000), TDigit(n/100%10), TDigit(n/10%10), TDigit(n%10)});
+}
+
+std::string to_string(const Word& word)
+{
+    std::string s;
+    for (std::size_t i = 0; i < word_size; ++i)
+    {
+        auto d = dec(word.digits()[i]);
+        s += d < base ? d + '0' : d;
+    }
+    return s + word.sign();
+}
+
+/// @Return the word for a string of 10 digits and a sign.  Blank digits and signs may be
+/// given as '_'.
+Word to_word(const std::string& s)
+{
+    if (s.size() != word_size + 1)
+        throw std::runtime_error("bad word: " + s);
+    std::array<TDigit, word_size+1> digits;
+    for (std::size_t i = 0; i < word_size; ++i)
+    {
+        if (s[i] != '_' && (s[i] < '0' || s[i] > '9'))
+            throw std::runtime_error("bad digit in word: " + s);
+        digits[i] = s[i] == '_' ? '_' : s[i] - '0';
+    }
+    auto sign = s[word_size];
+    if (sign != '+' && sign != '-' && sign != '_')
+        throw std::runtime_error("bad sign in word: " + s);
+    digits[word_size] = sign;
+    return Word(digits);
+}
+
+Address to_address(const std::string& s)
+{
+    if (s.size() != address_size
+        || !std::all_of(s.begin(), s.end(), [](char c) { return '0' <= c && c <= '9'; }))
+        throw std::runtime_error("bad address: " + s);
+    return Address({TDigit(s[0]-'0'), TDigit(s[1]-'0'), TDigit(s[2]-'0'), TDigit(s[3]-'0')});
+}
+
+/// @Return the address for a string of 4 digits.  Throws std::runtime_error if it's not a
+/// drum address.
+Address to_drum_address(const std::string& s)
+{
+    auto address = to_address(s);
+    if (address.value() >= static_cast<int>(n_bands*band_size))
+        throw std::runtime_error("not a drum address: " + s);
+    return address;
+}
+
+std::string to_string(const Address& address)
+{
+    std::ostringstream os;
+    os << address;
+    return os.str();
+}
+
+/// Blank cards are put in the punch hopper this many at a time.
+constexpr std::size_t blank_cards = 10;
+
+void connect(const std::shared_ptr<Computer>& computer,
+             const std::shared_ptr<Input_Output_Unit>& unit)
+{
+    unit->connect_source_client(computer);
+    unit->connect_sink_client(computer);
+    computer->connect_source(unit);
+    computer->connect_sink(unit);
+}
+
+/// Do what an operator would for a job that's waiting for the card unit.  @Return false if
+/// there's nothing to do because all of the cards have been read.
+bool tend(Input_Output_Unit& unit)
+{
+    // The punch stops when its hopper runs out.  Starting it again with more cards completes
+    // the punch that's waiting.
+    if (unit.sink_hold() == Card_Hold::hopper_empty)
+    {
+        unit.load_punch_hopper(Card_Deck(blank_cards));
+        unit.punch_start();
+        return true;
+    }
+    // The hopper is empty but the last cards are still in the feed.  End of file runs them
+    // through, a card for each press until one is at the read station.
+    if (unit.is_read_idle() && unit.source_hold() == Card_Hold::end_of_file)
+    {
+        unit.end_of_file();
+        return true;
+    }
+    return false;
+}
+
+/// @Return the text after a keyword and a single space.  Card lines may start with blanks.
+std::string rest_of_line(std::istream& ls)
+{
+    std::string text;
+    if (ls.get() == ' ')
+        std::getline(ls, text);
+    return text;
+}
+
+const std::array<const char*, 6> status_names {"stopped", "overflow", "error", "quota_exceeded",
+                                               "card_wait", "failed"};
+}
+
+void IBM650::start_job(const std::shared_ptr<Computer>& computer,
+                       const std::shared_ptr<Input_Output_Unit>& unit, const Job& job)
+{
+    for (const auto& [address, word] : job.drum)
+    {
+        if (address.value() >= static_cast<int>(n_bands*band_size))
+            throw std::runtime_error("not a drum address: " + to_string(address));
+        computer->set_drum(address, word);
+    }
+    if (!job.storage_entry.is_number())
+        throw std::runtime_error("no entry instruction");
+    computer->set_storage_entry(job.storage_entry);
+    computer->set_programmed_mode(Computer::Programmed_Mode::stop);
+    computer->set_control_mode(Computer::Control_Mode::run);
+    computer->set_overflow_mode(Computer::Overflow_Mode::stop);
+    computer->set_error_mode(Computer::Error_Mode::stop);
+    // Run a half cycle at a time so the limit can be checked between instructions.
+    computer->set_half_cycle_mode(Computer::Half_Cycle_Mode::half);
+    computer->computer_reset();
+
+    connect(computer, unit);
+    // A job without cards leaves the reader stopped.
+    if (!job.deck.empty())
+    {
+        unit->load_read_hopper(job.deck);
+        unit->read_start();
+    }
+    unit->load_punch_hopper(Card_Deck(blank_cards));
+    unit->punch_start();
+}
+
+bool IBM650::continue_job(Computer& computer, Input_Output_Unit& unit, TTime word_time_limit,
+                          Job_Result::Status& status)
+{
+    while (computer.run_time() < word_time_limit)
+        if (step_job(computer, status)
+            && (status != Job_Result::Status::card_wait || !tend(unit)))
+            return true;
+    status = Job_Result::Status::quota_exceeded;
+    return false;
+}
+
+bool IBM650::step_job(Computer& computer, Job_Result::Status& status)
+{
+    if (computer.storage_selection_error())
+    {
+        status = Job_Result::Status::error;
+        return true;
+    }
+    // Instruction half cycle.  The operation register is loaded.
+    auto run_status = computer.run_for(std::numeric_limits<TTime>::max());
+    if (computer.storage_selection_error())
+    {
+        status = Job_Result::Status::error;
+        return true;
+    }
+    // Data half cycle.  The operation is executed.
+    if (run_status == Computer::Run_Status::half_cycle)
+        run_status = computer.run_for(std::numeric_limits<TTime>::max());
+
+    switch (run_status)
+    {
+    case Computer::Run_Status::stopped:
+    case Computer::Run_Status::stop_requested:
+        status = Job_Result::Status::stopped;
+        return true;
+    case Computer::Run_Status::overflow:
+        status = Job_Result::Status::overflow;
+        return true;
+    case Computer::Run_Status::error:
+        status = Job_Result::Status::error;
+        return true;
+    case Computer::Run_Status::card_wait:
+        status = Job_Result::Status::card_wait;
+        return true;
+    default:
+        return false;
+    }
+}
+
+Job_Result IBM650::job_result(Computer& computer, const Input_Output_Unit& unit,
+                              Job_Result::Status status)
+{
+    Job_Result result;
+    result.status = status;
+    result.run_time = computer.run_time();
+    auto mode = computer.get_display_mode();
+    computer.set_display_mode(Computer::Display_Mode::distributor);
+    result.distributor = computer.display();
+    computer.set_display_mode(Computer::Display_Mode::upper_accumulator);
+    result.upper = computer.display();
+    computer.set_display_mode(Computer::Display_Mode::lower_accumulator);
+    result.lower = computer.display();
+    computer.set_display_mode(mode);
+    result.address = computer.address_register();
+    for (std::size_t n = 0; n < n_bands*band_size; ++n)
+    {
+        auto address = to_address(n);
+        auto word = computer.get_drum(address);
+        if (!word.is_blank())
+            result.drum.emplace_back(address, word);
+    }
+    result.punched = unit.punch_stacker_deck();
+    return result;
+}
+
+Job_Result IBM650::run_job(const std::shared_ptr<Computer>& computer, const Job& job,
+                           TTime word_time_limit)
+{
+    auto unit = std::make_shared<Input_Output_Unit>();
+    start_job(computer, unit, job);
+    Job_Result::Status status;
+    continue_job(*computer, *unit, word_time_limit, status);
+    return job_result(*computer, *unit, status);
+}
+
+Job IBM650::read_job(std::istream& is)
+{
+    Job job;
+    std::string line;
+    while (std::getline(is, line))
+    {
+        std::istringstream ls(line);
+        std::string key;
+        if (!(ls >> key))
+            continue;
+        if (key == "run")
+            return job;
+        if (key == "card")
+        {
+            job.deck.push_back(text_to_card(rest_of_line(ls)));
+            continue;
+        }
+
+        std::string value;
+        ls >> value;
+        if (key == "priority")
+            job.priority = std::stoi(value);
+        else if (key == "limit")
+            job.word_time_limit = std::stoll(value);
+        else if (key == "entry")
+            job.storage_entry = to_word(value);
+        else if (key == "drum")
+        {
+            std::string word;
+            ls >> word;
+            job.drum.emplace_back(to_drum_address(value), to_word(word));
+        }
+        else
+            throw std::runtime_error("unknown keyword: " + key);
+    }
+    throw std::runtime_error("job ended without \"run\"");
+}
+
+void IBM650::write_job(std::ostream& os, const Job& job)
+{
+    os << "priority " << job.priority << '\n'
+       << "limit " << job.word_time_limit << '\n'
+       << "entry " << to_string(job.storage_entry) << '\n';
+    for (const auto& [address, word] : job.drum)
+        os << "drum " << address << ' ' << to_string(word) << '\n';
+    for (const auto& card : job.deck)
+        os << "card " << card_to_text(card) << '\n';
+    os << "run\n";
+}
+
+Job_Result IBM650::read_result(std::istream& is)
+{
+    Job_Result result;
+    std::string line;
+    while (std::getline(is, line))
+    {
+        std::istringstream ls(line);
+        std::string key;
+        if (!(ls >> key))
+            continue;
+        if (key == "end")
+            return result;
+        if (key == "card")
+        {
+            result.punched.push_back(text_to_card(rest_of_line(ls)));
+            continue;
+        }
+
+        std::string value;
+        ls >> value;
+        if (key == "status")
+        {
+            auto it = std::find(status_names.begin(), status_names.end(), value);
+            if (it == status_names.end())
+                throw std::runtime_error("unknown status: " + value);
+            result.status = Job_Result::Status(std::distance(status_names.begin(), it));
+        }
+        else if (key == "time")
+            result.run_time = std::stoll(value);
+        else if (key == "distributor")
+            result.distributor = to_word(value);
+        else if (key == "upper")
+            result.upper = to_word(value);
+        else if (key == "lower")
+            result.lower = to_word(value);
+        else if (key == "address")
+            result.address = to_address(value);
+        else if (key == "message")
+        {
+            // The message is the rest of the line.
+            std::getline(ls, result.message);
+            result.message = value + result.message;
+        }
+        else if (key == "drum")
+        {
+            std::string word;
+            ls >> word;
+            result.drum.emplace_back(to_drum_address(value), to_word(word));
+        }
+        else
+            throw std::runtime_error("unknown keyword: " + key);
+    }
+    throw std::runtime_error("result ended without \"end\"");
+}
+
+void IBM650::write_result(std::ostream& os, const Job_Result& result)
+{
+    os << "status " << status_names[static_cast<std::size_t>(result.status)] << '\n';
+    // A job that failed didn't run, so there's no machine state.
+    if (result.status == Job_Result::Status::failed)
+    {
+        os << "message " << result.message << "\nend\n";
+        return;
+    }
+    os << "time " << result.run_time << '\n'
+       << "distributor " << to_string(result.distributor) << '\n'
+       << "upper " << to_string(result.upper) << '\n'
+       << "lower " << to_string(result.lower) << '\n'
+       << "address " << to_string(result.address) << '\n';
+    for (const auto& [address, word] : result.drum)
+        os << "drum " << address << ' ' << to_string(word) << '\n';
+    for (const auto& card : result.punched)
+        os << "card " << card_to_text(card) << '\n';
+    os << "end\n";
+}
+
+Computer_Pool::Computer_Pool()
+{
+    m_prototype.power_on();
+    while (!m_prototype.is_ready())
+        m_prototype.step(1);
+}
+
+std::shared_ptr<Computer> Computer_Pool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_idle.empty())
+        {
+            auto computer = std::move(m_idle.back());
+            m_idle.pop_back();
+            return computer;
+        }
+    }
+    return std::make_shared<Computer>(m_prototype);
+}
+
+void Computer_Pool::release(std::shared_ptr<Computer> computer)
+{
+    // Put the computer back in the warmed-up state so the next job doesn't see this one's drum
+    // or drum position.
+    *computer = m_prototype;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idle.push_back(std::move(computer));
+}
+
+std::size_t Computer_Pool::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idle.size();
+}
+
+bool Job_Queue::Item::operator<(const Item& item) const
+{
+    // The top of the queue is the highest priority, then the lowest sequence number.
+    return priority < item.priority
+        || (priority == item.priority && sequence > item.sequence);
+}
+
+void Job_Queue::push(Job job, std::function<void(const Job_Result&)> done)
+{
+    push(Entry{std::move(job), std::move(done), std::string()});
+}
+
+void Job_Queue::push(Entry entry)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto priority = entry.job.priority;
+        m_items.push({priority, m_sequence++, std::make_shared<Entry>(std::move(entry))});
+    }
+    m_ready.notify_one();
+}
+
+bool Job_Queue::pop(Entry& entry)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_ready.wait(lock, [this] { return m_closed || !m_items.empty(); });
+    if (m_items.empty())
+        return false;
+    entry = std::move(*m_items.top().entry);
+    m_items.pop();
+    return true;
+}
+
+void Job_Queue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_ready.notify_all();
+}
+
+std::size_t Job_Queue::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_items.size();
+}
+
+Job_Server::Job_Server(std::size_t n_workers, TTime word_time_quota, TTime time_slice,
+                       std::shared_ptr<const Result_Cache> cache)
+    : m_word_time_quota(word_time_quota),
+      m_time_slice(time_slice),
+      m_cache(cache)
+{
+    for (std::size_t i = 0; i < n_workers; ++i)
+        m_workers.emplace_back(&Job_Server::work, this);
+}
+
+Job_Server::~Job_Server()
+{
+    m_queue.close();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void Job_Server::submit(const Job& job, std::function<void(const Job_Result&)> done)
+{
+    m_queue.push(job, std::move(done));
+}
+
+void Job_Server::work()
+{
+    Job_Queue::Entry entry;
+    while (m_queue.pop(entry))
+    {
+        // The effective limit is part of the job for the cache.
+        entry.job.word_time_limit = entry.job.word_time_limit > 0
+            ? std::min(entry.job.word_time_limit, m_word_time_quota)
+            : m_word_time_quota;
+        auto limit = entry.job.word_time_limit;
+        if (m_cache && entry.checkpoint.empty())
+            if (auto result = m_cache->find(entry.job))
+            {
+                entry.done(*result);
+                continue;
+            }
+
+        auto computer = m_pool.acquire();
+        auto unit = std::make_shared<Input_Output_Unit>();
+        auto slice_limit = limit;
+        Job_Result::Status status;
+        bool done;
+        try
+        {
+            if (entry.checkpoint.empty())
+                start_job(computer, unit, entry.job);
+            else
+            {
+                std::istringstream is(entry.checkpoint);
+                computer->load_state(is);
+                unit->load_state(is);
+                connect(computer, unit);
+            }
+            // Written so a large slice can't overflow.
+            if (m_time_slice > 0 && limit - computer->run_time() > m_time_slice)
+                slice_limit = computer->run_time() + m_time_slice;
+            done = continue_job(*computer, *unit, slice_limit, status);
+        }
+        catch (const std::exception& e)
+        {
+            // A bad job mustn't take the server down.  The computer's state is unknown, so
+            // it's not returned to the pool.
+            Job_Result result;
+            result.status = Job_Result::Status::failed;
+            result.message = e.what();
+            entry.done(result);
+            continue;
+        }
+        if (!done && slice_limit < limit)
+        {
+            // Out of time for this slice.  Save the machine and its card unit and go to the
+            // back of the line for this job's priority.
+            std::ostringstream os;
+            computer->save_state(os);
+            unit->save_state(os);
+            entry.checkpoint = os.str();
+            m_pool.release(std::move(computer));
+            m_queue.push(std::move(entry));
+            continue;
+        }
+        auto result = job_result(*computer, *unit, status);
+        m_pool.release(std::move(computer));
+        if (m_cache)
+        {
+            try
+            {
+                m_cache->store(entry.job, result);
+            }
+            catch (const std::exception&)
+            {
+                // The result is still good.  It just won't be reused.
+            }
+        }
+        entry.done(result);
+    }
+}
@@ -0,0 +1,207 @@
+#ifndef JOB_HPP
+#define JOB_HPP
+
+#include "computer.hpp"
+#include "input_output_unit.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace IBM650
+{
+class Result_Cache;
+
+using Drum_Image = std::vector<std::pair<Address, Word>>;
+
+/// A batch run: a drum image, a deck of cards to read, the storage-entry switches that start
+/// it, and its limits.
+struct Job
+{
+    /// Words to write to the drum before starting.  Addresses not listed are cleared.
+    Drum_Image drum;
+    /// Cards for the program to read, in order.
+    IBM533::Card_Deck deck;
+    /// The first instruction.  Program start executes it from address 8000.
+    Word storage_entry;
+    /// The maximum number of word times the job may run.  Zero means the server's quota.
+    TTime word_time_limit = 0;
+    /// Higher priorities run first.  Jobs with the same priority run in submission order.
+    int priority = 0;
+};
+
+struct Job_Result
+{
+    enum class Status
+    {
+        /// A stop instruction was executed.
+        stopped,
+        /// The accumulator overflowed with the overflow switch set to "stop".
+        overflow,
+        /// A checking light came on.
+        error,
+        /// The job used up its word times before stopping.
+        quota_exceeded,
+        /// A read instruction was reached after all of the cards were read.
+        card_wait,
+        /// The job couldn't be run.  The message says why.
+        failed,
+    };
+    Status status;
+    /// Word times from program start to the end of the job.
+    TTime run_time = 0;
+    Word distributor;
+    Word upper;
+    Word lower;
+    Address address;
+    /// The non-blank words on the drum at the end of the job.
+    Drum_Image drum;
+    /// The cards punched by the program, in order.
+    IBM533::Card_Deck punched;
+    /// Why the job failed.  Empty unless the status is failed.
+    std::string message;
+};
+
+/// Set up a computer to run the passed-in job from the beginning.  The computer must be
+/// ready.  Only the job's words are written to the drum, so use a new computer, or one from
+/// Computer_Pool::acquire() for repeatable results.  The computer is connected to the card
+/// unit, which must be new and must be kept for the rest of the job.  The job's deck is put
+/// in the read hopper and blank cards in the punch hopper, and both are started.  Throws
+/// std::runtime_error if the drum image has an address that's not on the drum, or if the job
+/// has no entry instruction.
+void start_job(const std::shared_ptr<Computer>& computer,
+               const std::shared_ptr<IBM533::Input_Output_Unit>& unit, const Job& job);
+/// Run a started job until it stops or its run time reaches word_time_limit.  The card unit
+/// is tended like an operator would: more blank cards go in the punch hopper when it runs
+/// out, and end of file is pressed when the last cards of the deck are in the read feed.
+/// The job is always left between instructions, so it may be checkpointed and continued
+/// later.  @Return true if the job stopped by itself.  Set status to the reason it stopped.
+bool continue_job(Computer& computer, IBM533::Input_Output_Unit& unit, TTime word_time_limit,
+                  Job_Result::Status& status);
+/// Run one instruction of a started job.  @Return true if the job stopped.  Set status to
+/// the reason it stopped.
+bool step_job(Computer& computer, Job_Result::Status& status);
+/// @Return the final state of a job.
+Job_Result job_result(Computer& computer, const IBM533::Input_Output_Unit& unit,
+                      Job_Result::Status status);
+/// Start a job on a new card unit and run it until it stops or reaches its limit.
+Job_Result run_job(const std::shared_ptr<Computer>& computer, const Job& job,
+                   TTime word_time_limit);
+
+/// Read a job in the text submission format.  Throws std::runtime_error if the request is
+/// malformed.  See write_job() for the format.
+Job read_job(std::istream& is);
+/// Write a job in the text submission format: one "keyword value" per line, ending with
+/// "run".  Words are 10 digits followed by a sign.  Each card of the deck is a "card" line
+/// followed by a space and the card as a line of a text deck.  See text_deck.hpp.
+///   priority 2
+///   limit 100000
+///   entry 0000001000+
+///   drum 1000 6511581013-
+///   card 000000012{
+///   run
+void write_job(std::ostream& os, const Job& job);
+/// Read a result written by write_result().  Throws std::runtime_error if it's malformed.
+Job_Result read_result(std::istream& is);
+/// Write a result as "keyword value" lines ending with "end".  Punched cards are "card" lines
+/// like the job's deck.  A failed result has only its status and message.
+void write_result(std::ostream& os, const Job_Result& result);
+
+/// Computers that have been powered on and warmed up.  Pressing "power on" and waiting for
+/// DC is paid once per computer instead of once per job.
+class Computer_Pool
+{
+public:
+    /// Make the computer that pooled computers are copied from, and warm it up.
+    Computer_Pool();
+
+    /// @Return a ready computer.  A new one is made if the pool is empty.  Computers are
+    /// shared so that they can be connected to card units.
+    std::shared_ptr<Computer> acquire();
+    /// Return a computer to the pool.
+    void release(std::shared_ptr<Computer> computer);
+    /// @Return the number of idle computers.
+    std::size_t size() const;
+
+private:
+    /// A computer in the state it's in after being turned on and warmed up.
+    Computer m_prototype;
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<Computer>> m_idle;
+};
+
+/// Jobs waiting to run, ordered by priority, then by submission order.
+class Job_Queue
+{
+public:
+    struct Entry
+    {
+        Job job;
+        /// Called with the result when the job is finished.
+        std::function<void(const Job_Result&)> done;
+        /// The saved states of the computer and card unit of a job that was preempted.  Empty
+        /// if the job hasn't started.
+        std::string checkpoint;
+    };
+
+    void push(Job job, std::function<void(const Job_Result&)> done);
+    void push(Entry entry);
+    /// Wait for a job.  @Return false if the queue was closed and is empty.
+    bool pop(Entry& entry);
+    /// Wake up all waiting pops.  Jobs already queued are still returned.
+    void close();
+    std::size_t size() const;
+
+private:
+    struct Item
+    {
+        int priority;
+        std::size_t sequence;
+        std::shared_ptr<Entry> entry;
+        bool operator<(const Item& item) const;
+    };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::priority_queue<Item> m_items;
+    std::size_t m_sequence = 0;
+    bool m_closed = false;
+};
+
+/// Runs queued jobs on a fixed number of worker threads with a pool of warm computers.  Long
+/// jobs are preempted so they can't starve short ones.  A job that runs for a time slice
+/// without stopping is checkpointed and queued again behind the jobs of the same priority.
+/// It's continued later, possibly on another worker.
+class Job_Server
+{
+public:
+    /// Start the workers.  No job may run for more than word_time_quota word times.  Jobs
+    /// are preempted after time_slice word times, or never if time_slice is 0.  If a cache is
+    /// passed in, jobs that have been run before return the saved result.
+    Job_Server(std::size_t n_workers, TTime word_time_quota, TTime time_slice = 0,
+               std::shared_ptr<const Result_Cache> cache = nullptr);
+    /// Finish the queued jobs and stop the workers.
+    ~Job_Server();
+
+    /// Queue a job.  The callback is called from a worker thread when the job is done.
+    void submit(const Job& job, std::function<void(const Job_Result&)> done);
+
+private:
+    void work();
+
+    TTime m_word_time_quota;
+    TTime m_time_slice;
+    std::shared_ptr<const Result_Cache> m_cache;
+    Computer_Pool m_pool;
+    Job_Queue m_queue;
+    std::vector<std::thread> m_workers;
+};
+}
+
+#endif
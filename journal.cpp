@@ -0,0 +1,234 @@
+#include "journal.hpp"
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace IBM650;
+using namespace IBM533;
+
+namespace
+{
+// A journal starts with a format tag and version, then the computer and card unit
+// snapshots.  Each event is its type, the 8-byte word time, and then its 8-byte value, word,
+// address or deck as needed.  Cards take 2 bytes per column.
+const char journal_format[] = {'I', '6', '5', 'J'};
+const std::uint16_t journal_version = 2;
+constexpr auto n_event_types = static_cast<int>(Event::Type::run_for) + 1;
+
+template <typename T>
+void put(std::ostream& os, T value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(std::istream& is)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    if (!is.read(reinterpret_cast<char*>(&value), sizeof(value)))
+        throw std::runtime_error("journal ended early");
+    return value;
+}
+
+template <std::size_t N>
+void put_register(std::ostream& os, const Register<N>& reg)
+{
+    os.write(reg.digits().data(), N);
+}
+
+template <std::size_t N>
+void get_register(std::istream& is, Register<N>& reg)
+{
+    if (!is.read(reg.digits().data(), N))
+        throw std::runtime_error("journal ended early");
+}
+
+void put_deck(std::ostream& os, const Card_Deck& deck)
+{
+    put(os, static_cast<std::uint32_t>(deck.size()));
+    for (const auto& card : deck)
+        for (auto column : card)
+            put(os, static_cast<std::uint16_t>(column));
+}
+
+Card_Deck get_deck(std::istream& is)
+{
+    // Add cards as they're read so a bad count fails at the end of the journal.
+    Card_Deck deck;
+    auto n_cards = get<std::uint32_t>(is);
+    for (std::uint32_t i = 0; i < n_cards; ++i)
+    {
+        Card card;
+        for (auto& column : card)
+            column = get<std::uint16_t>(is);
+        deck.push_back(card);
+    }
+    return deck;
+}
+
+bool has_value(Event::Type type)
+{
+    switch (type)
+    {
+    case Event::Type::step:
+    case Event::Type::set_programmed_mode:
+    case Event::Type::set_half_cycle_mode:
+    case Event::Type::set_control_mode:
+    case Event::Type::set_display_mode:
+    case Event::Type::set_overflow_mode:
+    case Event::Type::set_error_mode:
+    case Event::Type::run_for:
+        return true;
+    default:
+        return false;
+    }
+}
+}
+
+void IBM650::apply(const Event& event, Computer& computer, Input_Output_Unit& unit)
+{
+    switch (event.type)
+    {
+    case Event::Type::power_on: computer.power_on(); break;
+    case Event::Type::power_off: computer.power_off(); break;
+    case Event::Type::dc_on: computer.dc_on(); break;
+    case Event::Type::dc_off: computer.dc_off(); break;
+    case Event::Type::master_power_off: computer.master_power_off(); break;
+    case Event::Type::step: computer.step(event.value); break;
+
+    case Event::Type::set_storage_entry: computer.set_storage_entry(event.word); break;
+    case Event::Type::set_programmed_mode:
+        computer.set_programmed_mode(Computer::Programmed_Mode(event.value));
+        break;
+    case Event::Type::set_half_cycle_mode:
+        computer.set_half_cycle_mode(Computer::Half_Cycle_Mode(event.value));
+        break;
+    case Event::Type::set_control_mode:
+        computer.set_control_mode(Computer::Control_Mode(event.value));
+        break;
+    case Event::Type::set_display_mode:
+        computer.set_display_mode(Computer::Display_Mode(event.value));
+        break;
+    case Event::Type::set_overflow_mode:
+        computer.set_overflow_mode(Computer::Overflow_Mode(event.value));
+        break;
+    case Event::Type::set_error_mode:
+        computer.set_error_mode(Computer::Error_Mode(event.value));
+        break;
+    case Event::Type::set_address: computer.set_address(event.address); break;
+
+    case Event::Type::transfer: computer.transfer(); break;
+    case Event::Type::program_start: computer.program_start(); break;
+    case Event::Type::program_reset: computer.program_reset(); break;
+    case Event::Type::computer_reset: computer.computer_reset(); break;
+    case Event::Type::accumulator_reset: computer.accumulator_reset(); break;
+    case Event::Type::error_reset: computer.error_reset(); break;
+    case Event::Type::error_sense_reset: computer.error_sense_reset(); break;
+
+    case Event::Type::load_read_hopper: unit.load_read_hopper(event.deck); break;
+    case Event::Type::load_punch_hopper: unit.load_punch_hopper(event.deck); break;
+    case Event::Type::read_start: unit.read_start(); break;
+    case Event::Type::punch_start: unit.punch_start(); break;
+    case Event::Type::read_stop: unit.read_stop(); break;
+    case Event::Type::punch_stop: unit.punch_stop(); break;
+    case Event::Type::end_of_file: unit.end_of_file(); break;
+
+    case Event::Type::program_stop: computer.program_stop(); break;
+    case Event::Type::run_for: computer.run_for(event.value); break;
+    }
+}
+
+Journal_Recorder::Journal_Recorder(Computer& computer, Input_Output_Unit& unit,
+                                   std::ostream& journal)
+    : m_computer(computer),
+      m_unit(unit),
+      m_journal(journal)
+{
+    check();
+    m_journal.write(journal_format, sizeof(journal_format));
+    put(m_journal, journal_version);
+    m_computer.save_state(m_journal);
+    m_unit.save_state(m_journal);
+}
+
+void Journal_Recorder::apply(const Event& event)
+{
+    check();
+    put(m_journal, event.type);
+    put(m_journal, static_cast<std::int64_t>(m_computer.run_time()));
+    if (has_value(event.type))
+        put(m_journal, static_cast<std::int64_t>(event.value));
+    else if (event.type == Event::Type::set_storage_entry)
+        put_register(m_journal, event.word);
+    else if (event.type == Event::Type::set_address)
+        put_register(m_journal, event.address);
+    else if (event.type == Event::Type::load_read_hopper
+             || event.type == Event::Type::load_punch_hopper)
+        put_deck(m_journal, event.deck);
+    // Flush so the journal is complete up to the event if the event brings the program
+    // down.
+    m_journal.flush();
+    IBM650::apply(event, m_computer, m_unit);
+}
+
+void Journal_Recorder::check() const
+{
+    if (m_unit.is_read_hopper_streamed())
+        throw std::runtime_error("can't journal a read hopper loaded from a card reader");
+}
+
+Journal_Player::Journal_Player(Computer& computer, Input_Output_Unit& unit,
+                               std::istream& journal)
+    : m_computer(computer),
+      m_unit(unit),
+      m_journal(journal)
+{
+    char format[sizeof(journal_format)];
+    if (!m_journal.read(format, sizeof(format))
+        || std::memcmp(format, journal_format, sizeof(format)) != 0)
+        throw std::runtime_error("not a journal");
+    auto version = get<std::uint16_t>(m_journal);
+    if (version != journal_version)
+        throw std::runtime_error("unsupported journal version " + std::to_string(version));
+    m_computer.load_state(m_journal);
+    m_unit.load_state(m_journal);
+}
+
+bool Journal_Player::step()
+{
+    if (m_journal.peek() == std::istream::traits_type::eof())
+        return false;
+    Event event;
+    auto type = get<std::uint8_t>(m_journal);
+    if (type >= n_event_types)
+        throw std::runtime_error("bad event type in journal");
+    event.type = Event::Type(type);
+    auto run_time = get<std::int64_t>(m_journal);
+    if (has_value(event.type))
+        event.value = get<std::int64_t>(m_journal);
+    else if (event.type == Event::Type::set_storage_entry)
+        get_register(m_journal, event.word);
+    else if (event.type == Event::Type::set_address)
+        get_register(m_journal, event.address);
+    else if (event.type == Event::Type::load_read_hopper
+             || event.type == Event::Type::load_punch_hopper)
+        event.deck = get_deck(m_journal);
+
+    if (run_time != m_computer.run_time())
+        throw std::runtime_error("replay went differently: event at word time "
+                                 + std::to_string(run_time) + " came at "
+                                 + std::to_string(m_computer.run_time()));
+    IBM650::apply(event, m_computer, m_unit);
+    return true;
+}
+
+void Journal_Player::run()
+{
+    while (step())
+        ;
+}
@@ -0,0 +1,123 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include "computer.hpp"
+#include "input_output_unit.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+
+namespace IBM650
+{
+/// Something an operator or a script does to the computer's console or the card unit.
+struct Event
+{
+    enum class Type : std::uint8_t
+    {
+        // Power and time.  value is the number of seconds for step.
+        power_on,
+        power_off,
+        dc_on,
+        dc_off,
+        master_power_off,
+        step,
+        // Console switches.  value is the switch position for the mode switches.
+        set_storage_entry,
+        set_programmed_mode,
+        set_half_cycle_mode,
+        set_control_mode,
+        set_display_mode,
+        set_overflow_mode,
+        set_error_mode,
+        set_address,
+        // Console keys.
+        transfer,
+        program_start,
+        program_reset,
+        computer_reset,
+        accumulator_reset,
+        error_reset,
+        error_sense_reset,
+        // Card unit.
+        load_read_hopper,
+        load_punch_hopper,
+        read_start,
+        punch_start,
+        read_stop,
+        punch_stop,
+        end_of_file,
+        // Types added later go here so older journals still read.
+        /// Press the program stop key between runs.  A stop pressed from another thread
+        /// while the program runs can't be recorded.
+        program_stop,
+        /// Run the program with Computer::run_for().  value is the number of word times.
+        run_for,
+    };
+
+    Type type;
+    /// A count or switch position.
+    std::int64_t value = 0;
+    /// The setting of the storage-entry switches.
+    Word word;
+    /// The setting of the address switches.
+    Address address;
+    /// The cards put in a hopper.
+    IBM533::Card_Deck deck;
+};
+
+/// Do what the event says to the computer or the card unit.
+void apply(const Event& event, Computer& computer, IBM533::Input_Output_Unit& unit);
+
+/// Records events in a compact binary journal as they're applied.  The journal starts with
+/// snapshots of the computer and the card unit.  Each event is stored with the word time it
+/// took effect.  Since the emulator is deterministic, replaying the events from the
+/// snapshots reproduces the run exactly.
+///
+/// Only what's done through the recorder is recorded.  A read hopper loaded from a
+/// Card_Reader can't be, since the cards aren't known until they're pulled, so the recorder
+/// refuses to start or go on with one.
+class Journal_Recorder
+{
+public:
+    /// Start a journal on the passed-in stream with snapshots of the current states.  Throws
+    /// std::runtime_error if the unit's read hopper is streamed.
+    Journal_Recorder(Computer& computer, IBM533::Input_Output_Unit& unit,
+                     std::ostream& journal);
+
+    /// Record the event and apply it.  Throws std::runtime_error without recording if the
+    /// unit's read hopper has been loaded from a Card_Reader since the last event.
+    void apply(const Event& event);
+
+private:
+    /// Throw if the session can't be recorded.
+    void check() const;
+
+    Computer& m_computer;
+    IBM533::Input_Output_Unit& m_unit;
+    std::ostream& m_journal;
+};
+
+/// Replays a journal written by Journal_Recorder without the console.
+class Journal_Player
+{
+public:
+    /// Restore the computer and card unit to the states at the start of the journal.  Throws
+    /// std::runtime_error if the stream is not a journal of the current version.
+    Journal_Player(Computer& computer, IBM533::Input_Output_Unit& unit,
+                   std::istream& journal);
+
+    /// Apply the next event.  @Return false at the end of the journal.  Throws
+    /// std::runtime_error if the journal is bad, or if the event's word time is not the
+    /// recorded one, which means the replay has gone differently.
+    bool step();
+    /// Apply the rest of the events.
+    void run();
+
+private:
+    Computer& m_computer;
+    IBM533::Input_Output_Unit& m_unit;
+    std::istream& m_journal;
+};
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+std::runtime_error file_error(const std::string& what, const std::string& path)
+{
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+}
+
+Mapped_File::Mapped_File(const std::string& path, std::size_t size)
+    : m_size(size)
+{
+    auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0)
+    {
+        m_created = true;
+        if (::ftruncate(fd, size) != 0)
+        {
+            auto error = file_error("can't size", path);
+            ::close(fd);
+            throw error;
+        }
+    }
+    else if (errno == EEXIST)
+        fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0)
+        throw file_error("can't open", path);
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) != size)
+    {
+        ::close(fd);
+        throw std::runtime_error(path + " is not " + std::to_string(size) + " bytes");
+    }
+    auto data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps the file open.
+    ::close(fd);
+    if (data == MAP_FAILED)
+        throw file_error("can't map", path);
+    m_data = static_cast<char*>(data);
+}
+
+Mapped_File::Mapped_File(const std::string& path)
+{
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw file_error("can't open", path);
+    struct stat status;
+    if (::fstat(fd, &status) != 0)
+    {
+        auto error = file_error("can't read the size of", path);
+        ::close(fd);
+        throw error;
+    }
+    m_size = status.st_size;
+    if (m_size == 0)
+    {
+        // Empty mappings aren't allowed.
+        ::close(fd);
+        throw std::runtime_error(path + " is empty");
+    }
+    auto data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        throw file_error("can't map", path);
+    m_data = static_cast<char*>(data);
+}
+
+Mapped_File::~Mapped_File()
+{
+    ::munmap(m_data, m_size);
+}
+
+char* Mapped_File::data()
+{
+    return m_data;
+}
+
+const char* Mapped_File::data() const
+{
+    return m_data;
+}
+
+std::size_t Mapped_File::size() const
+{
+    return m_size;
+}
+
+bool Mapped_File::created() const
+{
+    return m_created;
+}
+
+void Mapped_File::flush()
+{
+    if (::msync(m_data, m_size, MS_SYNC) != 0)
+        throw std::runtime_error(std::string("can't flush mapped file: ") + std::strerror(errno));
+}
@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/// A file mapped into memory.  Changes to the memory go to the page cache and reach the file
+/// when flush() is called, when the mapping is destroyed, or whenever the system gets to it.
+class Mapped_File
+{
+public:
+    /// Map the file at path for reading and writing.  If the file doesn't exist, it's created
+    /// with size zero bytes.  Throws std::runtime_error if the file can't be opened or
+    /// mapped, or if an existing file isn't size bytes long.
+    Mapped_File(const std::string& path, std::size_t size);
+    /// Map all of an existing file for reading only.  The data must not be written.  Throws
+    /// std::runtime_error if the file can't be opened or mapped.
+    explicit Mapped_File(const std::string& path);
+    ~Mapped_File();
+    Mapped_File(const Mapped_File&) = delete;
+    Mapped_File& operator=(const Mapped_File&) = delete;
+
+    char* data();
+    const char* data() const;
+    std::size_t size() const;
+    /// @Return true if the file was created by the constructor.
+    bool created() const;
+
+    /// Write changes to the file and wait for them to finish.  Throws std::runtime_error on
+    /// failure.
+    void flush();
+
+private:
+    char* m_data = nullptr;
+    std::size_t m_size;
+    bool m_created = false;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "pacer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+using namespace IBM650;
+using namespace std::chrono;
+
+namespace
+{
+/// How much earlier than the target to wake from sleep.  The rest of the wait is a spin.
+/// Sleeps on a loaded desktop commonly overshoot by a few hundred microseconds.
+constexpr auto spin_time = microseconds(500);
+/// Re-anchor if the host falls further behind than this.  A tenth of a second of emulated
+/// time is noticeable to a person watching the console lights.
+constexpr auto max_lag = milliseconds(100);
+}
+
+Pacer::Pacer(Computer& computer, double speed, TTime batch)
+    : m_computer(computer),
+      m_speed(speed),
+      m_batch(batch)
+{
+    start();
+}
+
+void Pacer::set_speed(double speed)
+{
+    m_speed = speed;
+    start();
+}
+
+double Pacer::speed() const
+{
+    return m_speed;
+}
+
+Computer::Run_Status Pacer::run_batch()
+{
+    auto status = m_computer.run_for(m_batch);
+    if (m_speed == unlimited)
+        return status;
+    if (status == Computer::Run_Status::card_wait)
+    {
+        // Nothing ran.  Don't make up the hold when the program continues.
+        start();
+        return status;
+    }
+
+    auto wake = target();
+    auto now = Clock::now();
+    if (now - wake > max_lag)
+    {
+        // The batch took too long to run.  Don't try to catch up.
+        ++m_drift.n_resets;
+        start();
+        return status;
+    }
+    if (wake - now > spin_time)
+        std::this_thread::sleep_until(wake - spin_time);
+    while ((now = Clock::now()) < wake)
+        ;
+    record_drift(now - wake);
+    return status;
+}
+
+Computer::Run_Status Pacer::catch_up()
+{
+    if (m_speed == unlimited)
+        return m_computer.run_for(m_batch);
+
+    auto now = Clock::now();
+    auto lag = now - target();
+    if (lag > max_lag)
+    {
+        ++m_drift.n_resets;
+        start();
+        lag = max_lag;
+    }
+    if (lag <= nanoseconds::zero())
+        return Computer::Run_Status::time_limit;
+    // Run at least a word time so a caller with a fast timer still makes progress.
+    auto word_times = std::min(duration<double, std::micro>(lag).count()*m_speed
+                               / microseconds_per_word_time,
+                               static_cast<double>(std::numeric_limits<TTime>::max()));
+    auto status = m_computer.run_for(std::max(static_cast<TTime>(word_times), TTime(1)));
+    if (status == Computer::Run_Status::card_wait)
+    {
+        // The held program's run time doesn't advance.  Measure the next lag from now so
+        // it's counted once as hold time.
+        start();
+        return status;
+    }
+    record_drift(Clock::now() - target());
+    return status;
+}
+
+const Pacer::Drift& Pacer::drift() const
+{
+    return m_drift;
+}
+
+void Pacer::reset_drift()
+{
+    m_drift = Drift();
+}
+
+void Pacer::start()
+{
+    m_anchor_time = Clock::now();
+    m_anchor_run_time = m_computer.run_time();
+}
+
+Pacer::Clock::time_point Pacer::target() const
+{
+    auto emulated = duration<double, std::micro>(
+        (m_computer.run_time() - m_anchor_run_time)*microseconds_per_word_time/m_speed);
+    return m_anchor_time + duration_cast<Clock::duration>(emulated);
+}
+
+void Pacer::record_drift(nanoseconds drift)
+{
+    auto n = ++m_drift.n_batches;
+    m_drift.last = drift;
+    m_drift.mean += (drift - m_drift.mean)/static_cast<nanoseconds::rep>(n);
+    m_drift.max = std::max(m_drift.max, drift);
+}
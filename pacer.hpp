@@ -0,0 +1,82 @@
+#ifndef PACER_HPP
+#define PACER_HPP
+
+#include "computer.hpp"
+
+#include <chrono>
+
+namespace IBM650
+{
+/// Runs the computer at the speed of the real 650, or a multiple of it, for demonstrations
+/// and training.  The program runs in batches of word times.  After each batch the pacer
+/// waits until the host's monotonic clock catches up with the time the batch would have
+/// taken on the real machine.  The wait is a sleep that ends a little early followed by a
+/// short spin, which keeps the jitter well under a word time on most hosts.
+///
+/// Emulated time is measured from an anchor that's set by start(), when the speed
+/// changes, and when the host falls too far behind to catch up.  So pauses and slow batches
+/// don't make the pacer run flat out to make up for lost time.
+class Pacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// A speed for running as fast as the host can.  Nothing is timed, so there's no cost
+    /// over calling Computer::run_for() directly.
+    static constexpr double unlimited = 0.0;
+
+    /// How far the pacer's wake-ups were from when they should have been.  Positive drift is
+    /// late.
+    struct Drift
+    {
+        std::size_t n_batches = 0;
+        std::chrono::nanoseconds last{0};
+        std::chrono::nanoseconds mean{0};
+        std::chrono::nanoseconds max{0};
+        /// The number of times the host fell behind and the anchor was reset.
+        std::size_t n_resets = 0;
+    };
+
+    /// Pace the computer at speed times the real 650.  Run batch word times between waits.
+    Pacer(Computer& computer, double speed = 1.0, TTime batch = 1000);
+
+    /// Start measuring emulated time from now.  Call when a program is started after the
+    /// computer has been idle.
+    void start();
+    /// Change the speed multiplier.  Pass unlimited to stop pacing.
+    void set_speed(double speed);
+    double speed() const;
+
+    /// Run a batch and then wait for the host clock to catch up.  @Return the reason the
+    /// computer paused.  Run_Status::time_limit means the program is still running.
+    Computer::Run_Status run_batch();
+    /// Run the program as far as the host clock says it should have got by now, without
+    /// waiting.  For callers that have their own timer, like the console's.  @Return the
+    /// reason the computer paused.
+    ///
+    /// While the program is held waiting for the card unit, each call passes the time
+    /// since the last one to the computer as hold time.  The held time isn't made up when
+    /// the program continues.
+    Computer::Run_Status catch_up();
+
+    /// @Return the drift statistics since construction or the last reset_drift().
+    const Drift& drift() const;
+    void reset_drift();
+
+private:
+    /// @Return the host time at which the computer's run time should be reached.
+    Clock::time_point target() const;
+    void record_drift(std::chrono::nanoseconds drift);
+
+    Computer& m_computer;
+    double m_speed;
+    TTime m_batch;
+
+    Clock::time_point m_anchor_time;
+    TTime m_anchor_run_time;
+
+    Drift m_drift;
+};
+}
+
+#endif
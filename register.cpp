@@ -6,10 +6,12 @@ using namespace IBM650;
 
 TDigit IBM650::bin(TDigit number)
 {
+    // Anything else that's not a decimal digit gets all bits set, which is not a code.
     return number == '_' ? 0
-        : bi_quinary_code[number == '-' ? 8
-                          : number == '+' ? 9
-                          : number];
+        : number == '-' ? bi_quinary_code[8]
+        : number == '+' ? bi_quinary_code[9]
+        : number < 0 || number >= base ? 0x7f
+        : bi_quinary_code[number];
 }
 
 TDigit IBM650::dec(TDigit code)
@@ -22,7 +22,7 @@ constexpr std::array<TDigit, base> bi_quinary_code {'!','\"','$','(','0','A','B'
 
 /// @Return the bi-quinary code for a given integer.  E.g. bin(3) returns 'B'.  If number
 /// is '_' return 0 (no bits).  Since signs are encoded as digits, return 8 for '-', 9
-/// for '+'.
+/// for '+'.  Any other number that's not a decimal digit gives an invalid code.
 TDigit bin(TDigit number);
 /// @Return the integer for a given bi-quinary code.  dec() is the inverse of bin() for
 /// integer arguments in [0, base), and '_'.  I.e. dec(0) returns '_'.  If the argument of
@@ -40,7 +40,6 @@ template <std::size_t N> class Register
 public:
     /// Make a register initialized with all bits unset.
     Register();
-    virtual ~Register() = default;
     /// Make a register initialized with the codes for the digits in passed-in integer
     /// array.  The character '_' may be passed to indicate a blank (all bits unset).
     Register(const std::array<TDigit, N>& digits);
@@ -74,8 +73,8 @@ public:
     bool operator!=(const Register<N>& reg) const;
 
     /// @Return the code for the nth most significant digit.
-    virtual TDigit& operator[](std::size_t n);
-    virtual const TDigit& operator[](std::size_t n) const;
+    TDigit& operator[](std::size_t n);
+    const TDigit& operator[](std::size_t n) const;
 
     Register<N>& operator++();
 
@@ -229,8 +228,6 @@ public:
 
     /// @Return the sign as a character: +, -, _, or ?.
     TDigit sign() const;
-    virtual TDigit& operator[](std::size_t n) override;
-    virtual const TDigit& operator[](std::size_t n) const override;
 };
 
 template <std::size_t N>
@@ -274,19 +271,6 @@ TDigit Signed_Register<N>::sign() const
         : '?';
 }
 
-template <std::size_t N>
-TDigit& Signed_Register<N>::operator[](std::size_t n)
-{
-    return Register<N+1>::digits()[N-n];
-}
-
-template <std::size_t N>
-const TDigit& Signed_Register<N>::operator[](std::size_t n) const
-{
-    assert(0 <= n && n <= N);
-    return Register<N+1>::digits()[N-n];
-}
-
 template <std::size_t N>
 Signed_Register<N> shift(const Signed_Register<N>& reg, std::size_t left)
 {
@@ -0,0 +1,90 @@
+#include "result_cache.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace IBM650;
+
+namespace
+{
+/// @Return the 64-bit FNV-1a hash of a string.
+std::uint64_t hash(const std::string& s)
+{
+    std::uint64_t h = 0xcbf29ce484222325;
+    for (unsigned char c : s)
+    {
+        h ^= c;
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+}
+
+Result_Cache::Result_Cache(const std::string& directory)
+    : m_directory(directory)
+{
+    std::filesystem::create_directories(m_directory);
+}
+
+std::string Result_Cache::key(const Job& job)
+{
+    // Priority doesn't affect the result.
+    Job key_job(job);
+    key_job.priority = 0;
+    std::ostringstream os;
+    os << "version " << IBM650_VERSION << '\n'
+       << "timing " << timing_model_version << '\n';
+    write_job(os, key_job);
+    return os.str();
+}
+
+std::optional<Job_Result> Result_Cache::find(const Job& job) const
+{
+    auto job_key = key(job);
+    std::ifstream is(path(job_key));
+    if (!is)
+        return std::nullopt;
+
+    // The file starts with the key.  Check it in case of a hash collision.
+    std::string stored_key(job_key.size(), '\0');
+    if (!is.read(stored_key.data(), stored_key.size()) || stored_key != job_key)
+        return std::nullopt;
+    try
+    {
+        return read_result(is);
+    }
+    catch (const std::exception&)
+    {
+        // Treat a damaged file as a miss.  It'll be replaced when the result is stored.
+        return std::nullopt;
+    }
+}
+
+void Result_Cache::store(const Job& job, const Job_Result& result) const
+{
+    auto job_key = key(job);
+    auto file = path(job_key);
+    // Write to a temporary file and rename so that readers never see a partial file.
+    std::ostringstream temp;
+    temp << file << '.' << std::this_thread::get_id() << ".tmp";
+    {
+        std::ofstream os(temp.str());
+        os << job_key;
+        write_result(os, result);
+        if (!os)
+            throw std::runtime_error("can't write " + temp.str());
+    }
+    std::filesystem::rename(temp.str(), file);
+}
+
+std::string Result_Cache::path(const std::string& key) const
+{
+    std::ostringstream os;
+    os << std::hex << std::setw(16) << std::setfill('0') << hash(key);
+    return (std::filesystem::path(m_directory) / (os.str() + ".result")).string();
+}
@@ -0,0 +1,37 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include "job.hpp"
+
+#include <optional>
+#include <string>
+
+namespace IBM650
+{
+/// Results of finished jobs saved in files named by a hash of everything that determines
+/// the result: the drum image, the card deck, the storage-entry switches and the word-time
+/// limit, plus the emulator version and timing_model_version.  Running the same job again returns the
+/// saved result.
+class Result_Cache
+{
+public:
+    /// Use the passed-in directory for the cache.  It's made if it doesn't exist.
+    Result_Cache(const std::string& directory);
+
+    /// @Return the saved result for the job, if there is one.
+    std::optional<Job_Result> find(const Job& job) const;
+    /// Save the result of a job.
+    void store(const Job& job, const Job_Result& result) const;
+
+    /// @Return the description of the job's starting state that's used as the cache key.
+    static std::string key(const Job& job);
+
+private:
+    /// @Return the name of the file for a key.
+    std::string path(const std::string& key) const;
+
+    std::string m_directory;
+};
+}
+
+#endif
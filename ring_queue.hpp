@@ -0,0 +1,60 @@
+#ifndef RING_QUEUE_HPP
+#define RING_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/// A fixed-capacity queue for passing items from one thread to another without locks.
+/// Exactly one thread may push and exactly one thread may pop.  Neither ever waits.
+template <typename T, std::size_t N> class Ring_Queue
+{
+public:
+    /// Add an item to the back of the queue.  @Return false if the queue is full.
+    bool push(T item);
+    /// Remove the item at the front of the queue.  @Return false if the queue is empty.
+    bool pop(T& item);
+    /// @Return true if there's nothing to pop.  Only a hint unless called from the popping
+    /// thread.
+    bool empty() const;
+
+private:
+    // One slot is left unused to tell full from empty.
+    std::array<T, N+1> m_items;
+    /// The index of the next item to pop.  Written only by the popping thread.
+    std::atomic<std::size_t> m_head = 0;
+    /// The index of the next item to push.  Written only by the pushing thread.
+    std::atomic<std::size_t> m_tail = 0;
+};
+
+template <typename T, std::size_t N>
+bool Ring_Queue<T, N>::push(T item)
+{
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto next = (tail + 1) % (N + 1);
+    if (next == m_head.load(std::memory_order_acquire))
+        return false;
+    m_items[tail] = std::move(item);
+    m_tail.store(next, std::memory_order_release);
+    return true;
+}
+
+template <typename T, std::size_t N>
+bool Ring_Queue<T, N>::pop(T& item)
+{
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+        return false;
+    item = std::move(m_items[head]);
+    m_head.store((head + 1) % (N + 1), std::memory_order_release);
+    return true;
+}
+
+template <typename T, std::size_t N>
+bool Ring_Queue<T, N>::empty() const
+{
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+#endif
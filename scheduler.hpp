@@ -0,0 +1,171 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace IBM650
+{
+/// Time on the shared machine clock in microseconds.
+using TClock = std::int64_t;
+constexpr TClock microseconds_per_second = 1000000;
+/// The time it takes for a word to pass under the drum heads.
+constexpr TClock microseconds_per_word_time = 96;
+
+/// A discrete-event kernel: a clock and a priority queue of events that are due at times on
+/// that clock.  Time passes only in jumps to the next event, so a long wait costs one pop no
+/// matter how long it is.
+///
+/// Events are values, usually enums, that the owner handles itself.  Unlike callbacks they
+/// can be compared, cancelled, copied with their owner, and saved in snapshots.  Events due
+/// at the same time are popped in the order they were scheduled.
+template <typename Event> class Scheduler
+{
+public:
+    /// @Return the time on the clock.
+    TClock now() const { return m_now; }
+    /// @Return true if no events are pending.
+    bool empty() const { return m_events.empty(); }
+    /// @Return the number of pending events.
+    std::size_t size() const { return m_events.size(); }
+    /// @Return true if the event is pending.
+    bool is_pending(Event event) const;
+    /// @Return the time the next event is due.  Must not be empty.
+    TClock next_time() const;
+
+    /// Schedule an event to happen after a delay from now.
+    void schedule(TClock delay, Event event);
+    /// Remove all pending copies of an event.
+    void cancel(Event event);
+    /// Remove all pending events.  The clock is not changed.
+    void clear();
+
+    /// If an event is due at or before end_time, advance the clock to it, remove it, and set
+    /// event to it.  Otherwise advance the clock to end_time.  @Return true if an event was
+    /// removed.  Handle all events up to a time with
+    ///     while (scheduler.pop(end_time, event))
+    ///         handle(event);
+    bool pop(TClock end_time, Event& event);
+
+    void save(Snapshot::Writer& snapshot) const;
+    /// Replace the clock and events with ones saved by save().
+    void load(Snapshot::Reader& snapshot);
+
+private:
+    struct Entry
+    {
+        TClock time;
+        /// Breaks ties between events due at the same time.
+        std::uint64_t sequence;
+        Event event;
+    };
+    /// Ordering for a min-heap on time then sequence.
+    static bool later(const Entry& a, const Entry& b);
+
+    TClock m_now = 0;
+    std::uint64_t m_next_sequence = 0;
+    /// A heap with the next event at the front.
+    std::vector<Entry> m_events;
+};
+
+template <typename Event>
+bool Scheduler<Event>::later(const Entry& a, const Entry& b)
+{
+    return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+}
+
+template <typename Event>
+bool Scheduler<Event>::is_pending(Event event) const
+{
+    return std::any_of(m_events.begin(), m_events.end(),
+                       [event](const Entry& e) { return e.event == event; });
+}
+
+template <typename Event>
+TClock Scheduler<Event>::next_time() const
+{
+    assert(!m_events.empty());
+    return m_events.front().time;
+}
+
+template <typename Event>
+void Scheduler<Event>::schedule(TClock delay, Event event)
+{
+    assert(delay >= 0);
+    m_events.push_back({m_now + delay, m_next_sequence++, event});
+    std::push_heap(m_events.begin(), m_events.end(), later);
+}
+
+template <typename Event>
+void Scheduler<Event>::cancel(Event event)
+{
+    auto end = std::remove_if(m_events.begin(), m_events.end(),
+                              [event](const Entry& e) { return e.event == event; });
+    if (end == m_events.end())
+        return;
+    m_events.erase(end, m_events.end());
+    std::make_heap(m_events.begin(), m_events.end(), later);
+}
+
+template <typename Event>
+void Scheduler<Event>::clear()
+{
+    m_events.clear();
+}
+
+template <typename Event>
+bool Scheduler<Event>::pop(TClock end_time, Event& event)
+{
+    if (m_events.empty() || m_events.front().time > end_time)
+    {
+        m_now = std::max(m_now, end_time);
+        return false;
+    }
+    std::pop_heap(m_events.begin(), m_events.end(), later);
+    m_now = m_events.back().time;
+    event = m_events.back().event;
+    m_events.pop_back();
+    return true;
+}
+
+template <typename Event>
+void Scheduler<Event>::save(Snapshot::Writer& snapshot) const
+{
+    // Save in heap order.  Sequence numbers are saved so ties keep their order.
+    snapshot.put(m_now);
+    snapshot.put(m_next_sequence);
+    snapshot.put_count(m_events.size());
+    for (const auto& entry : m_events)
+    {
+        snapshot.put(entry.time);
+        snapshot.put(entry.sequence);
+        snapshot.put(entry.event);
+    }
+}
+
+template <typename Event>
+void Scheduler<Event>::load(Snapshot::Reader& snapshot)
+{
+    auto now = snapshot.get<TClock>();
+    auto next_sequence = snapshot.get<std::uint64_t>();
+    std::vector<Entry> events(snapshot.get_count(sizeof(TClock) + sizeof(std::uint64_t)
+                                                 + sizeof(Event)));
+    for (auto& entry : events)
+    {
+        entry.time = snapshot.get<TClock>();
+        entry.sequence = snapshot.get<std::uint64_t>();
+        entry.event = snapshot.get<Event>();
+    }
+    // Don't trust the order in the snapshot.
+    std::make_heap(events.begin(), events.end(), later);
+    m_now = now;
+    m_next_sequence = next_sequence;
+    m_events = std::move(events);
+}
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/// Support for the binary snapshot formats of the computer and the card unit.  A snapshot is
+/// a header followed by the payload.  The header is 4 characters that identify the format, a
+/// 2-byte format version, and the 4-byte size of the payload.  Numbers are in the host's byte
+/// order.  The payload is written and read all at once.
+namespace Snapshot
+{
+constexpr std::size_t magic_size = 4;
+constexpr std::size_t header_size = magic_size + sizeof(std::uint16_t) + sizeof(std::uint32_t);
+
+/// Collects a payload and writes it with its header.
+class Writer
+{
+public:
+    /// Append the bytes of a number, bool or enum.
+    template <typename T> void put(T value);
+    void put_bytes(const char* data, std::size_t n);
+    /// Append a 4-byte count of items that follow.  Throws std::runtime_error if the count
+    /// doesn't fit.
+    void put_count(std::size_t count);
+    /// Write the header and the payload.  Throws std::runtime_error if the payload is too big
+    /// for its 4-byte size.
+    void write(std::ostream& os, const char* magic, std::uint16_t version) const;
+
+private:
+    std::string m_payload;
+};
+
+/// Reads a payload and takes values from it in the order they were put.
+class Reader
+{
+public:
+    /// Read a snapshot.  Throws std::runtime_error if it's not the passed-in format and
+    /// version, or if the stream ends early.
+    Reader(std::istream& is, const char* magic, std::uint16_t version);
+
+    template <typename T> T get();
+    /// @Return a pointer to the next n bytes of the payload.
+    const char* get_bytes(std::size_t n);
+    /// @Return a 4-byte count of items that follow.  Throws std::runtime_error if there's
+    /// not enough payload left for that many items of item_size bytes.
+    std::size_t get_count(std::size_t item_size);
+    /// Throws std::runtime_error if any of the payload was not used.
+    void finish() const;
+
+private:
+    std::string m_payload;
+    std::size_t m_position = 0;
+};
+
+template <typename T>
+void Writer::put(T value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    put_bytes(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void Writer::put_bytes(const char* data, std::size_t n)
+{
+    m_payload.append(data, n);
+}
+
+inline void Writer::put_count(std::size_t count)
+{
+    if (count > std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error("too many items for a snapshot");
+    put(static_cast<std::uint32_t>(count));
+}
+
+inline void Writer::write(std::ostream& os, const char* magic, std::uint16_t version) const
+{
+    if (m_payload.size() > std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error("snapshot payload too big");
+    char header[header_size];
+    std::uint32_t size = m_payload.size();
+    std::memcpy(header, magic, magic_size);
+    std::memcpy(header + magic_size, &version, sizeof(version));
+    std::memcpy(header + magic_size + sizeof(version), &size, sizeof(size));
+    os.write(header, header_size);
+    os.write(m_payload.data(), m_payload.size());
+}
+
+inline Reader::Reader(std::istream& is, const char* magic, std::uint16_t version)
+{
+    char header[header_size];
+    if (!is.read(header, header_size))
+        throw std::runtime_error("snapshot ended early");
+    if (std::memcmp(header, magic, magic_size) != 0)
+        throw std::runtime_error("not a " + std::string(magic, magic_size) + " snapshot");
+    std::uint16_t stored_version;
+    std::memcpy(&stored_version, header + magic_size, sizeof(stored_version));
+    if (stored_version != version)
+        throw std::runtime_error("unsupported snapshot version "
+                                 + std::to_string(stored_version));
+    std::uint32_t size;
+    std::memcpy(&size, header + magic_size + sizeof(stored_version), sizeof(size));
+    // Read in pieces so that a corrupt size can't allocate much more than the stream holds.
+    constexpr std::size_t piece_size = 1 << 16;
+    while (m_payload.size() < size)
+    {
+        auto start = m_payload.size();
+        auto n = std::min<std::size_t>(piece_size, size - start);
+        m_payload.resize(start + n);
+        if (!is.read(m_payload.data() + start, n))
+            throw std::runtime_error("snapshot ended early");
+    }
+}
+
+template <typename T>
+T Reader::get()
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, get_bytes(sizeof(value)), sizeof(value));
+    return value;
+}
+
+inline const char* Reader::get_bytes(std::size_t n)
+{
+    if (m_position + n > m_payload.size())
+        throw std::runtime_error("snapshot ended early");
+    auto data = m_payload.data() + m_position;
+    m_position += n;
+    return data;
+}
+
+inline std::size_t Reader::get_count(std::size_t item_size)
+{
+    std::size_t count = get<std::uint32_t>();
+    if (count*item_size > m_payload.size() - m_position)
+        throw std::runtime_error("snapshot ended early");
+    return count;
+}
+
+inline void Reader::finish() const
+{
+    if (m_position != m_payload.size())
+        throw std::runtime_error("snapshot has extra data");
+}
+}
+
+#endif
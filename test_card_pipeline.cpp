@@ -0,0 +1,96 @@
+#include "card_pipeline.hpp"
+#include "doctest.h"
+
+#include <vector>
+
+using namespace IBM533;
+using namespace IBM650;
+
+namespace
+{
+/// A client that punches each card it reads with its words negated.
+struct Negating_Client : Source_Client, Sink_Client
+{
+    virtual void connect_source(std::weak_ptr<Source> src) override { source = src; }
+    virtual void resume_source_client() override { read_running = true; }
+    virtual void connect_sink(std::weak_ptr<Sink> snk) override { sink = snk; }
+    virtual void resume_sink_client() override { punch_running = true; }
+
+    void run() {
+        auto src = source.lock();
+        auto snk = sink.lock();
+        while (read_running && punch_running)
+        {
+            read_running = false;
+            punch_running = false;
+            for (const auto& word : src->get_source())
+                snk->get_sink().push_back(change_sign(word));
+            snk->advance_sink();
+            src->advance_source();
+        }
+    }
+
+    std::weak_ptr<Source> source;
+    std::weak_ptr<Sink> sink;
+    bool read_running = false;
+    bool punch_running = false;
+};
+
+Card numbered_card(std::size_t n)
+{
+    Buffer buffer(buffer_size, Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+    for (std::size_t i = 0; i < card_words; ++i)
+        buffer[i][i+1] = bin((n + i) % base);
+    return buffer_to_card(buffer);
+}
+}
+
+TEST_CASE("card pipeline")
+{
+    const std::size_t n_cards = 1000;
+    std::size_t n_read = 0;
+    std::vector<Card> punched;
+    auto pipeline = std::make_shared<Card_Pipeline>(
+        [&n_read](Card& card) {
+            if (n_read == n_cards)
+                return false;
+            card = numbered_card(n_read++);
+            return true;
+        },
+        [&punched](const Card& card) { punched.push_back(card); },
+        // Small queues so that the stages have to wait for each other.
+        4);
+    auto client = std::make_shared<Negating_Client>();
+    pipeline->connect_source_client(client);
+    pipeline->connect_sink_client(client);
+    client->connect_source(pipeline);
+    client->connect_sink(pipeline);
+
+    pipeline->start();
+    client->run();
+    pipeline->finish();
+
+    REQUIRE(punched.size() == n_cards);
+    for (std::size_t n = 0; n < n_cards; ++n)
+    {
+        auto buffer = card_to_buffer(punched[n]);
+        auto expected = card_to_buffer(numbered_card(n));
+        for (std::size_t i = 0; i < card_words; ++i)
+            CHECK(buffer[i] == change_sign(expected[i]));
+    }
+}
+
+TEST_CASE("card pipeline with no cards")
+{
+    std::vector<Card> punched;
+    auto pipeline = std::make_shared<Card_Pipeline>(
+        [](Card&) { return false; },
+        [&punched](const Card& card) { punched.push_back(card); });
+    auto client = std::make_shared<Negating_Client>();
+    pipeline->connect_source_client(client);
+    client->connect_source(pipeline);
+    pipeline->start();
+    CHECK(!client->read_running);
+    pipeline->finish();
+    CHECK(punched.empty());
+}
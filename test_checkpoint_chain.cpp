@@ -0,0 +1,53 @@
+#include "checkpoint_chain.hpp"
+#include "test_fixture.hpp"
+#include "doctest.h"
+
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+std::string snapshot(const Computer& computer)
+{
+    std::ostringstream os;
+    computer.save_state(os);
+    return os.str();
+}
+}
+
+TEST_CASE("checkpoint chain")
+{
+    Computer_Ready_Fixture f;
+    Checkpoint_Chain chain;
+    CHECK_THROWS(chain.restore(f.computer));
+
+    for (TDigit n = 0; n < 5; ++n)
+    {
+        f.computer.set_drum(Address({1,0,0,n}), Word({0,0, 0,0,0,0, 0,0,0,n, '+'}));
+        f.computer.set_distributor(Word({0,0, 0,0,0,0, 0,0,n,0, '+'}));
+        chain.checkpoint(f.computer);
+    }
+    CHECK(chain.length() == 5);
+    auto full_size = snapshot(f.computer).size();
+    // The 4 incremental checkpoints have 1 word each.
+    CHECK(chain.size() < 2*full_size);
+
+    Computer restored;
+    chain.restore(restored);
+    CHECK(snapshot(restored) == snapshot(f.computer));
+
+    chain.compact();
+    CHECK(chain.length() == 1);
+    CHECK(chain.size() == full_size);
+    Computer compacted;
+    chain.restore(compacted);
+    CHECK(snapshot(compacted) == snapshot(f.computer));
+
+    // The chain continues after compaction.
+    f.computer.set_drum(Address({1,9,9,9}), Word({0,0, 0,0,0,0, 0,0,0,9, '+'}));
+    chain.checkpoint(f.computer);
+    CHECK(chain.length() == 2);
+    chain.restore(compacted);
+    CHECK(snapshot(compacted) == snapshot(f.computer));
+}
@@ -2,6 +2,12 @@
 #include "test_fixture.hpp"
 #include "doctest.h"
 
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
 using namespace IBM650;
 
 TEST_CASE("turn comptuter on")
@@ -645,3 +651,255 @@ TEST_CASE("optimum 'reset and add lower' timing")
     CHECK(f.computer.run_time() == 17);
     CHECK(f.computer.display() == f.data);
 }
+
+TEST_CASE("save and restore state")
+{
+    Optimum_RAL_Fixture f;
+    f.computer.computer_reset();
+    f.computer.set_half_cycle_mode(Computer::Half_Cycle_Mode::half);
+    // Stop between the storage-entry no-op and the RAL instruction.
+    f.computer.program_start();
+    f.computer.program_start();
+
+    std::stringstream state;
+    f.computer.save_state(state);
+    Computer restored;
+    restored.load_state(state);
+    CHECK(restored.is_ready());
+    CHECK(restored.run_time() == f.computer.run_time());
+    CHECK(restored.instruction_address());
+    CHECK(restored.address_register() == f.computer.address_register());
+    CHECK(restored.get_drum(Address({1,1,5,8})) == f.data);
+
+    // Both machines finish the same way.
+    restored.set_half_cycle_mode(Computer::Half_Cycle_Mode::run);
+    f.computer.set_half_cycle_mode(Computer::Half_Cycle_Mode::run);
+    restored.program_start();
+    f.computer.program_start();
+    CHECK(restored.run_time() == 17);
+    CHECK(restored.display() == f.data);
+
+    std::stringstream truncated(state.str().substr(0, 100));
+    CHECK_THROWS(restored.load_state(truncated));
+    // A failed load doesn't change the computer.
+    CHECK(restored.run_time() == 17);
+
+    auto other_version = state.str();
+    other_version[4] += 1;
+    std::stringstream other_version_state(other_version);
+    CHECK_THROWS(restored.load_state(other_version_state));
+    std::stringstream not_a_snapshot("I533");
+    CHECK_THROWS(restored.load_state(not_a_snapshot));
+
+    // A huge size in the header fails at the end of the stream without allocating it.
+    auto huge = state.str().substr(0, 100);
+    std::uint32_t size = 0xffffffff;
+    std::memcpy(huge.data() + 6, &size, sizeof(size));
+    std::stringstream huge_state(huge);
+    CHECK_THROWS(restored.load_state(huge_state));
+}
+
+TEST_CASE("save and restore changes")
+{
+    Computer_Ready_Fixture f;
+    Word word({0,0, 1,2,3,4, 5,6,7,8, '-'});
+    f.computer.set_drum(Address({0,0,0,0}), word);
+    std::stringstream base;
+    f.computer.save_state(base);
+    f.computer.forget_changes();
+
+    f.computer.set_drum(Address({1,2,3,4}), word);
+    f.computer.set_drum(Address({1,9,9,9}), word);
+    f.computer.set_distributor(word);
+    std::stringstream changes;
+    f.computer.save_changes(changes);
+    // Only the 2 changed words are saved.
+    CHECK(changes.str().size() < base.str().size() - 1990*6);
+    // Nothing has changed since.
+    std::stringstream no_changes;
+    f.computer.save_changes(no_changes);
+    CHECK(no_changes.str().size() == changes.str().size() - 2*(2 + 6));
+
+    Computer restored;
+    restored.load_state(base);
+    CHECK(restored.get_drum(Address({1,2,3,4})) == Word());
+    restored.load_changes(changes);
+    CHECK(restored.get_drum(Address({0,0,0,0})) == word);
+    CHECK(restored.get_drum(Address({1,2,3,4})) == word);
+    CHECK(restored.get_drum(Address({1,9,9,9})) == word);
+    restored.set_display_mode(Computer::Display_Mode::distributor);
+    CHECK(restored.display() == word);
+
+    // A full snapshot is not a set of changes.
+    base.clear();
+    base.seekg(0);
+    CHECK_THROWS(restored.load_changes(base));
+    auto bad_word_number = changes.str();
+    // The last word's number is just before its 6 bytes.
+    bad_word_number[bad_word_number.size() - 8] = '\xff';
+    bad_word_number[bad_word_number.size() - 7] = '\xff';
+    std::stringstream bad_changes(bad_word_number);
+    CHECK_THROWS(restored.load_changes(bad_changes));
+}
+
+TEST_CASE("state hash")
+{
+    Computer_Ready_Fixture f;
+    Computer copy(f.computer);
+    auto hash = f.computer.state_hash();
+    CHECK(copy.state_hash() == hash);
+
+    Word word({0,0, 1,2,3,4, 5,6,7,8, '-'});
+    f.computer.set_drum(Address({1,2,3,4}), word);
+    CHECK(f.computer.state_hash() != hash);
+    f.computer.set_drum(Address({1,2,3,4}), Word());
+    CHECK(f.computer.state_hash() == hash);
+
+    // Same word at another address.
+    f.computer.set_drum(Address({1,2,3,4}), word);
+    copy.set_drum(Address({1,2,3,5}), word);
+    CHECK(copy.state_hash() != f.computer.state_hash());
+    copy.set_drum(Address({1,2,3,5}), Word());
+    copy.set_drum(Address({1,2,3,4}), word);
+    CHECK(copy.state_hash() == f.computer.state_hash());
+
+    f.computer.set_distributor(word);
+    CHECK(copy.state_hash() != f.computer.state_hash());
+
+    // The hash of a restored machine is computed from scratch.
+    std::stringstream state;
+    f.computer.save_state(state);
+    Computer restored;
+    restored.load_state(state);
+    CHECK(restored.state_hash() == f.computer.state_hash());
+}
+
+TEST_CASE("drum file")
+{
+    Temp_Path temp("IBM650_test_drum");
+    const auto& path = temp.path;
+    Word table_word({0,0, 1,2,3,4, 5,6,7,8, '-'});
+    {
+        Computer_Ready_Fixture f;
+        f.computer.set_drum(Address({1,2,3,4}), table_word);
+        // A new file gets the current contents.
+        f.computer.attach_drum_file(path.string());
+        CHECK(f.computer.get_drum(Address({1,2,3,4})) == table_word);
+        f.computer.set_drum(Address({1,9,9,9}), table_word);
+
+        // Copies don't write to the file.
+        Computer copy(f.computer);
+        copy.set_drum(Address({0,0,0,0}), table_word);
+        f.computer.flush_drum_file();
+    }
+    CHECK(std::filesystem::file_size(path) == 8 + 2000*6);
+
+    // The contents are still there after the power is off.
+    Computer_Ready_Fixture f;
+    f.computer.attach_drum_file(path.string());
+    CHECK(f.computer.get_drum(Address({1,2,3,4})) == table_word);
+    CHECK(f.computer.get_drum(Address({1,9,9,9})) == table_word);
+    CHECK(f.computer.get_drum(Address({0,0,0,0})) == Word());
+
+    // Detaching keeps the contents but not the connection to the file.
+    f.computer.detach_drum_file();
+    f.computer.set_drum(Address({0,0,0,0}), table_word);
+    CHECK(f.computer.get_drum(Address({1,2,3,4})) == table_word);
+    Computer reattached;
+    reattached.attach_drum_file(path.string());
+    CHECK(reattached.get_drum(Address({0,0,0,0})) == Word());
+    reattached.detach_drum_file();
+
+    std::filesystem::resize_file(path, 100);
+    CHECK_THROWS(f.computer.attach_drum_file(path.string()));
+}
+
+struct Loop_Fixture : public Run_Fixture
+{
+    Loop_Fixture() {
+        // A no-op at 0000 that goes to itself.
+        computer.set_drum(Address({0,0,0,0}), Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        computer.computer_reset();
+    }
+};
+
+TEST_CASE("bounded runs")
+{
+    SUBCASE("run to a stop")
+    {
+        RAL_Fixture f;
+        f.computer.computer_reset();
+        CHECK(f.computer.run_for(1000) == Computer::Run_Status::stopped);
+        CHECK(f.computer.run_time() == 155);
+    }
+    SUBCASE("run for a time")
+    {
+        Loop_Fixture f;
+        CHECK(f.computer.run_for(500) == Computer::Run_Status::time_limit);
+        auto t = f.computer.run_time();
+        CHECK(t >= 500);
+        CHECK(t < 600);
+        CHECK(f.computer.run_for(500) == Computer::Run_Status::time_limit);
+        CHECK(f.computer.run_time() >= t + 500);
+    }
+    SUBCASE("run until a condition")
+    {
+        Loop_Fixture f;
+        auto status = f.computer.run_until([](const Computer& c) {
+            return c.run_time() >= 200; });
+        CHECK(status == Computer::Run_Status::condition);
+        CHECK(f.computer.run_time() >= 200);
+    }
+    SUBCASE("half cycle")
+    {
+        RAL_Fixture f;
+        f.computer.set_half_cycle_mode(Computer::Half_Cycle_Mode::half);
+        f.computer.computer_reset();
+        CHECK(f.computer.run_for(1000) == Computer::Run_Status::half_cycle);
+    }
+    SUBCASE("manual")
+    {
+        Computer_Ready_Fixture f;
+        f.computer.set_control_mode(Computer::Control_Mode::manual);
+        CHECK(f.computer.run_for(1000) == Computer::Run_Status::manual);
+    }
+}
+
+TEST_CASE("program stop")
+{
+    SUBCASE("stop before running")
+    {
+        Loop_Fixture f;
+        f.computer.program_stop();
+        CHECK(f.computer.run_for(500) == Computer::Run_Status::stop_requested);
+        CHECK(f.computer.run_time() == 0);
+        // The request is used up.
+        CHECK(f.computer.run_for(500) == Computer::Run_Status::time_limit);
+    }
+    SUBCASE("reset clears the request")
+    {
+        Loop_Fixture f;
+        f.computer.program_stop();
+        f.computer.program_reset();
+        CHECK(f.computer.run_for(500) == Computer::Run_Status::time_limit);
+        f.computer.program_stop();
+        f.computer.computer_reset();
+        CHECK(f.computer.run_for(500) == Computer::Run_Status::time_limit);
+    }
+    SUBCASE("stop from another thread")
+    {
+        Loop_Fixture f;
+        std::atomic<bool> running = false;
+        std::thread stopper([&] {
+            while (!running)
+                std::this_thread::yield();
+            f.computer.program_stop();
+        });
+        auto status = f.computer.run_until([&running](const Computer&) {
+            running = true;
+            return false; });
+        stopper.join();
+        CHECK(status == Computer::Run_Status::stop_requested);
+    }
+}
@@ -0,0 +1,136 @@
+#include "deck_file.hpp"
+#include "test_fixture.hpp"
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace IBM533;
+
+namespace
+{
+/// @Return a card with n in every column.
+Card filled_card(int n)
+{
+    Card card;
+    card.fill(n);
+    return card;
+}
+
+struct Deck_File_Fixture : public Temp_Path
+{
+    Deck_File_Fixture() : Temp_Path("IBM650_test_deck") {}
+};
+}
+
+TEST_CASE("write and read a deck file")
+{
+    Deck_File_Fixture f;
+    Card_Deck deck{filled_card(0x001), filled_card(0x802), filled_card(0xfff)};
+    write_deck_file(f.path, deck);
+
+    auto reader = deck_file_reader(f.path);
+    Card card;
+    for (const auto& expected : deck)
+    {
+        REQUIRE(reader(card));
+        CHECK(card == expected);
+    }
+    CHECK(!reader(card));
+    CHECK(!reader(card));
+}
+
+TEST_CASE("empty deck file")
+{
+    Deck_File_Fixture f;
+    write_deck_file(f.path, Card_Deck());
+    auto reader = deck_file_reader(f.path);
+    Card card;
+    CHECK(!reader(card));
+}
+
+TEST_CASE("append to a deck file")
+{
+    Deck_File_Fixture f;
+    {
+        auto writer = deck_file_writer(f.path);
+        writer(filled_card(1));
+        writer(filled_card(2));
+    }
+    {
+        auto writer = deck_file_writer(f.path);
+        writer(filled_card(3));
+    }
+    auto reader = deck_file_reader(f.path);
+    Card card;
+    for (int n = 1; n <= 3; ++n)
+    {
+        REQUIRE(reader(card));
+        CHECK(card == filled_card(n));
+    }
+    CHECK(!reader(card));
+}
+
+TEST_CASE("background deck file writer")
+{
+    Deck_File_Fixture f;
+    {
+        // Small batches and queue to exercise waiting for room.
+        Deck_File_Writer writer(f.path, 3, 2);
+        for (int n = 0; n < 100; ++n)
+            writer.write(filled_card(n % 0x1000));
+        writer.flush();
+        CHECK(std::filesystem::file_size(f.path) == 8 + 100*Packed_Card::n_bytes);
+        writer.write(filled_card(100));
+        // Closed by the destructor.
+    }
+    auto reader = deck_file_reader(f.path);
+    Card card;
+    for (int n = 0; n <= 100; ++n)
+    {
+        REQUIRE(reader(card));
+        CHECK(card == filled_card(n));
+    }
+    CHECK(!reader(card));
+}
+
+TEST_CASE("write after closing")
+{
+    Deck_File_Fixture f;
+    Deck_File_Writer writer(f.path);
+    writer.write(filled_card(1));
+    writer.close();
+    CHECK_THROWS_AS(writer.write(filled_card(2)), std::runtime_error);
+    CHECK(std::filesystem::file_size(f.path) == 8 + Packed_Card::n_bytes);
+}
+
+TEST_CASE("background writer for a punch stacker")
+{
+    Deck_File_Fixture f;
+    Deck_File_Writer writer(f.path);
+    Input_Output_Unit unit;
+    unit.spill_punch_stacker(writer.card_writer(), 0, writer.card_flush());
+    unit.load_punch_hopper(Card_Deck(3, filled_card(7)));
+    unit.punch_start();
+    auto buffer = card_to_buffer(filled_card(0x802));
+    unit.get_sink() = buffer;
+    unit.advance_sink();
+    // The hopper ran out, so the punched card is in the file without an explicit flush.
+    CHECK(unit.is_punch_idle());
+    CHECK(std::filesystem::file_size(f.path) == 8 + Packed_Card::n_bytes);
+}
+
+TEST_CASE("bad deck files")
+{
+    Deck_File_Fixture f;
+    CHECK_THROWS(deck_file_reader(f.path));
+
+    std::ofstream(f.path) << "not a deck file";
+    CHECK_THROWS(deck_file_reader(f.path));
+    CHECK_THROWS(deck_file_writer(f.path));
+
+    // A partial card.
+    write_deck_file(f.path, Card_Deck(2));
+    std::filesystem::resize_file(f.path, std::filesystem::file_size(f.path) - 1);
+    CHECK_THROWS(deck_file_reader(f.path));
+}
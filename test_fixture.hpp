@@ -1,5 +1,10 @@
 #include "computer.hpp"
 
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+
 struct Computer_Ready_Fixture
 {
     Computer_Ready_Fixture() {
@@ -16,3 +21,19 @@ struct Run_Fixture : public Computer_Ready_Fixture
         computer.set_control_mode(IBM650::Computer::Control_Mode::run);
     }
 };
+
+/// A path in the temp directory for a test's files.  The process ID is added to the name so
+/// that test runs at the same time don't use each other's files.  Anything at the path is
+/// removed before and after the test.
+struct Temp_Path
+{
+    explicit Temp_Path(const std::string& name)
+        : path(std::filesystem::temp_directory_path()
+               / (name + "_" + std::to_string(getpid()))) {
+        std::filesystem::remove_all(path);
+    }
+    ~Temp_Path() {
+        std::filesystem::remove_all(path);
+    }
+    std::filesystem::path path;
+};
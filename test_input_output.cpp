@@ -1,10 +1,10 @@
-#include <boost/test/unit_test.hpp>
-
 #include "buffer.hpp"
 #include "input_output_unit.hpp"
 #include "register.hpp"
+#include "doctest.h"
 
 #include <iostream>
+#include <sstream>
 using namespace IBM533;
 using namespace IBM650;
 
@@ -53,163 +53,321 @@ const Card card4{0x010, 0x001, 0x010, 0x001, 0x010, 0x001, 0x010, 0x001, 0x010,
 
 const std::array<Card, 4> test_cards {card1, card2, card3, card4};
 
-BOOST_AUTO_TEST_CASE(initial_state)
+TEST_CASE("packed card")
+{
+    CHECK(sizeof(Packed_Card) == 120);
+    Packed_Card blank;
+    for (std::size_t i = 0; i < card_columns; ++i)
+        CHECK(blank.column(i) == 0);
+
+    for (const auto& card : test_cards)
+    {
+        Packed_Card packed(card);
+        CHECK(packed.unpack() == card);
+        CHECK(card_to_buffer(packed) == card_to_buffer(card));
+        auto buffer = card_to_buffer(card);
+        CHECK(buffer_to_packed_card(buffer) == Packed_Card(buffer_to_card(buffer)));
+    }
+
+    SUBCASE("neighbors are independent")
+    {
+        Packed_Card packed;
+        packed.set_column(10, 0xfff);
+        packed.set_column(11, 0xabc);
+        packed.set_column(10, 0x001);
+        CHECK(packed.column(9) == 0);
+        CHECK(packed.column(10) == 0x001);
+        CHECK(packed.column(11) == 0xabc);
+        CHECK(packed.column(12) == 0);
+    }
+    SUBCASE("extra bits are dropped")
+    {
+        Packed_Card packed;
+        packed.set_column(79, 0x1801);
+        CHECK(packed.column(79) == 0x801);
+        CHECK(packed != blank);
+    }
+}
+
+TEST_CASE("card conversion")
+{
+    SUBCASE("all digits and signs")
+    {
+        Buffer buffer(buffer_size);
+        for (std::size_t i = 0; i < card_words; ++i)
+        {
+            std::array<TDigit, word_size+1> digits;
+            for (std::size_t j = 0; j < word_size; ++j)
+                digits[j] = (i + j) % base;
+            digits[word_size] = i % 2 == 0 ? '+' : '-';
+            buffer[i] = Word(digits);
+        }
+        buffer[8] = zero;
+        buffer[9] = zero;
+        auto card = buffer_to_packed_card(buffer);
+        CHECK(card.column(0) == 0x001);
+        CHECK(card.column(9) == (0x200 | 0x800));
+        CHECK(card.column(19) == (0x001 | 0x400));
+        CHECK(card_to_buffer(card) == buffer);
+    }
+    SUBCASE("blank and double punched columns")
+    {
+        auto card = Packed_Card(card1);
+        card.set_column(3, 0);
+        card.set_column(9, 0x800);
+        card.set_column(42, 0x021);
+        Buffer buffer;
+        Card_Check check;
+        CHECK(!card_to_buffer(card, buffer, check));
+        CHECK(check.blank.count() == 2);
+        CHECK(check.blank[3]);
+        CHECK(check.blank[9]);
+        CHECK(check.multiple.count() == 1);
+        CHECK(check.multiple[42]);
+        // Blanks aren't digits.  The lowest of several punches is taken.
+        CHECK(!buffer[0].is_number());
+        CHECK(buffer[0].sign() == '+');
+        CHECK(dec(buffer[4].digits()[2]) == 0);
+
+        CHECK(card_to_buffer(Packed_Card(card1), buffer, check));
+        CHECK(check.is_valid());
+    }
+}
+
+TEST_CASE("double-buffered read")
 {
     Input_Output_Unit unit;
-    BOOST_CHECK(unit.is_on());
-    BOOST_CHECK(unit.is_read_idle());
-    BOOST_CHECK(unit.is_punch_idle());
-    BOOST_CHECK(!unit.is_read_feed_stopped());
-    BOOST_CHECK(!unit.is_end_of_file());
-    BOOST_CHECK(!unit.is_double_punch_or_blank());
+    unit.load_read_hopper(Card_Deck{card1, card2, card3, card4});
+    unit.read_start();
+    const auto& first = unit.get_source();
+    CHECK(first == card_to_buffer(card1));
+    unit.advance_source();
+    // The next card goes into the other buffer.
+    CHECK(first == card_to_buffer(card1));
+    CHECK(&unit.get_source() != &first);
+    CHECK(unit.get_source() == card_to_buffer(card2));
+}
+
+TEST_CASE("double punch or blank")
+{
+    auto blank = card2;
+    blank[17] = 0;
+    Input_Output_Unit unit;
+    unit.load_read_hopper(Card_Deck{card1, blank, card3, card4});
+    unit.read_start();
+    CHECK(!unit.is_double_punch_or_blank());
+    unit.advance_source();
+    CHECK(unit.is_double_punch_or_blank());
+    unit.advance_source();
+    // The light stays on until read start.
+    CHECK(unit.is_double_punch_or_blank());
+    unit.read_start();
+    CHECK(!unit.is_double_punch_or_blank());
+}
 
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK(unit.punch_hopper_deck().empty());
-    BOOST_CHECK(unit.punch_stacker_deck().empty());
+TEST_CASE("card feed")
+{
+    Packed_Deck stacker;
+    Card_Feed<3> feed;
+    CHECK(feed.is_empty());
+    CHECK(!feed.is_full());
+
+    Packed_Card card[] = {Packed_Card(card1), Packed_Card(card2), Packed_Card(card3)};
+    feed.advance(&card[0], stacker);
+    feed.advance(nullptr, stacker);
+    feed.advance(&card[1], stacker);
+    CHECK(*feed.station(0) == card[0]);
+    CHECK(feed.station(1) == nullptr);
+    CHECK(*feed.station(2) == card[1]);
+    CHECK(!feed.is_empty());
+    CHECK(!feed.is_full());
+    CHECK(stacker.empty());
+
+    feed.advance(&card[2], stacker);
+    CHECK(feed.station(0) == nullptr);
+    CHECK(stacker == Packed_Deck{card[0]});
+    feed.advance(nullptr, stacker);
+    CHECK(*feed.front() == card[1]);
+    CHECK(stacker.size() == 1);
+}
+
+TEST_CASE("card stacker")
+{
+    Card_Stacker stacker;
+    CHECK(stacker.empty());
+    Packed_Card card[] = {Packed_Card(card1), Packed_Card(card2), Packed_Card(card3),
+                          Packed_Card(card4)};
+    for (int i = 0; i < 100; ++i)
+        stacker.push_back(card[i % 4]);
+    // Take cards off the bottom a few at a time, like a stacker spilling with a window.
+    for (int i = 0; i < 96; i += 3)
+    {
+        CHECK(*stacker.begin() == card[i % 4]);
+        stacker.pop_front(3);
+        CHECK(stacker.size() == std::size_t(97 - i));
+    }
+    CHECK(*stacker.begin() == card[0]);
+    stacker.pop_front(stacker.size());
+    CHECK(stacker.empty());
 }
 
-BOOST_AUTO_TEST_CASE(read_start_0_cards)
+TEST_CASE("initial state")
+{
+    Input_Output_Unit unit;
+    CHECK(unit.is_on());
+    CHECK(unit.is_read_idle());
+    CHECK(unit.is_punch_idle());
+    CHECK(!unit.is_read_feed_stopped());
+    CHECK(!unit.is_end_of_file());
+    CHECK(!unit.is_double_punch_or_blank());
+
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.punch_hopper_deck().empty());
+    CHECK(unit.punch_stacker_deck().empty());
+}
+
+TEST_CASE("read start 0 cards")
 {
     Input_Output_Unit unit;
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
-    BOOST_CHECK(unit.is_read_idle());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
+    CHECK(unit.is_read_idle());
 }
 
-BOOST_AUTO_TEST_CASE(read_start_1_card)
+TEST_CASE("read start 1 card")
 {
     std::shared_ptr<Buffer> buffer;
     Input_Output_Unit unit;
     Card_Deck deck {card1};
     unit.load_read_hopper(deck);
-    BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 1);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
+    CHECK(unit.read_hopper_deck().size() == 1);
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
 
     unit.read_start();
     // Card at 1st station.
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
-    BOOST_CHECK(unit.is_read_idle());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
+    CHECK(unit.is_read_idle());
 
     unit.read_start();
     // Card passes 1st read brushes.
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
 
     unit.read_start();
     // Card passes 2nd read brushes.
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
-    BOOST_CHECK(card_to_buffer(card1) == unit.get_source());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == buffer_size);
+    CHECK(card_to_buffer(card1) == unit.get_source());
 
     unit.read_start();
     // Card is stacked.
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 1);
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().size() == 1);
 
-    BOOST_CHECK(unit.read_stacker_deck() == deck);
+    CHECK(unit.read_stacker_deck() == deck);
 }
 
-BOOST_AUTO_TEST_CASE(read_start_2_cards)
+TEST_CASE("read start 2 cards")
 {
     Input_Output_Unit unit;
     Card_Deck deck {card1, card2};
     unit.load_read_hopper(deck);
-    BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 2);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
+    CHECK(unit.read_hopper_deck().size() == 2);
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
 
     // Cards at 1 and 2
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
 
     // Cards at 2 and 3
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
-    BOOST_CHECK(card_to_buffer(card1) == unit.get_source());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == buffer_size);
+    CHECK(card_to_buffer(card1) == unit.get_source());
 
     // Card at 3
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 1);
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
-    BOOST_CHECK(card_to_buffer(card2) == unit.get_source());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().size() == 1);
+    CHECK(unit.get_source().size() == buffer_size);
+    CHECK(card_to_buffer(card2) == unit.get_source());
 
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 2);
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().size() == 2);
 
-    BOOST_CHECK(unit.read_stacker_deck() == deck);
+    CHECK(unit.read_stacker_deck() == deck);
 }
 
-BOOST_AUTO_TEST_CASE(read_start_3_cards)
+TEST_CASE("read start 3 cards")
 {
     Input_Output_Unit unit;
     Card_Deck deck {card1, card2, card3};
     unit.load_read_hopper(deck);
-    BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 3);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
+    CHECK(unit.read_hopper_deck().size() == 3);
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
 
     // Cards at 1, 2 and 3
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == buffer_size);
     // Don't empty the buffer this time.
 
     // Cards at 2 and 3
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 1);
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
-    BOOST_CHECK(card_to_buffer(card2) == unit.get_source());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().size() == 1);
+    CHECK(unit.get_source().size() == buffer_size);
+    CHECK(card_to_buffer(card2) == unit.get_source());
 
     // Card at 3
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 2);
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
-    BOOST_CHECK(card_to_buffer(card3) == unit.get_source());
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().size() == 2);
+    CHECK(unit.get_source().size() == buffer_size);
+    CHECK(card_to_buffer(card3) == unit.get_source());
 
     unit.read_start();
-    BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 3);
+    CHECK(unit.read_hopper_deck().empty());
+    CHECK(unit.read_stacker_deck().size() == 3);
 
-    BOOST_CHECK(unit.read_stacker_deck() == deck);
+    CHECK(unit.read_stacker_deck() == deck);
 }
 
-BOOST_AUTO_TEST_CASE(read_start_200_cards)
+TEST_CASE("read start 200 cards")
 {
     Input_Output_Unit unit;
     Card_Deck deck(200, card1);
     unit.load_read_hopper(deck);
-    BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 200);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
+    CHECK(unit.read_hopper_deck().size() == 200);
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == 0);
 
     // Cards at 1, 2 and 3
     unit.read_start();
-    BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 197);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
-    BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
-    BOOST_CHECK(card_to_buffer(card1) == unit.get_source());
+    CHECK(unit.read_hopper_deck().size() == 197);
+    CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.get_source().size() == buffer_size);
+    CHECK(card_to_buffer(card1) == unit.get_source());
 
     // Start does nothing with cards in the hopper.
     unit.read_start();
-    BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 197);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    CHECK(unit.read_hopper_deck().size() == 197);
+    CHECK(unit.read_stacker_deck().empty());
 }
 
 struct Mock_Source_Client : Source_Client
@@ -228,12 +386,7 @@ struct Mock_Source_Client : Source_Client
     }
     void fill_buffer() {
         if (auto src = source.lock())
-        {
-            buffer.clear();
-            Buffer& source_buffer = src->get_source();
-            for (; !source_buffer.empty(); source_buffer.pop_front())
-                buffer.push_back(source_buffer.front());
-        }
+            buffer = src->get_source();
     }
     std::weak_ptr<Source> source;
     Buffer buffer;
@@ -257,24 +410,24 @@ struct Card_Read_Fixture
     Card_Deck deck;
 };
 
-BOOST_AUTO_TEST_CASE(run_in)
+TEST_CASE("run in")
 {
     // See use case 1.
     Card_Read_Fixture f;
 
-    BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 4);
-    BOOST_CHECK(f.unit->read_stacker_deck().empty());
+    CHECK(f.unit->read_hopper_deck().size() == 4);
+    CHECK(f.unit->read_stacker_deck().empty());
     f.unit->read_start();
     // 3 cards in unit
-    BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 1);
-    BOOST_CHECK(f.unit->read_stacker_deck().empty());
+    CHECK(f.unit->read_hopper_deck().size() == 1);
+    CHECK(f.unit->read_stacker_deck().empty());
     // 1st card read into buffer
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card1) == f.client->buffer);
-    BOOST_CHECK(!f.unit->is_read_idle());
+    CHECK(card_to_buffer(card1) == f.client->buffer);
+    CHECK(!f.unit->is_read_idle());
 }
 
-BOOST_AUTO_TEST_CASE(read_instruction)
+TEST_CASE("read instruction")
 {
     Card_Read_Fixture f;
     f.unit->read_start();
@@ -283,45 +436,74 @@ BOOST_AUTO_TEST_CASE(read_instruction)
     // Computer executes a read instruction, transfers the buffer, signals advance.
     f.client->read();
     // Cards advance.
-    BOOST_CHECK(f.unit->read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    CHECK(f.unit->read_hopper_deck().empty());
+    CHECK(f.unit->read_stacker_deck().size() == 1);
     // Client gets resume signal.
-    BOOST_CHECK(f.client->running);
+    CHECK(f.client->running);
     // 2nd card read into buffer
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card2) == f.client->buffer);
+    CHECK(card_to_buffer(card2) == f.client->buffer);
     // Stacker deck is empty.
-    BOOST_CHECK(f.unit->is_read_idle());
+    CHECK(f.unit->is_read_idle());
 }
 
-BOOST_AUTO_TEST_CASE(reload_read_hopper)
+TEST_CASE("save and restore state")
+{
+    Card_Read_Fixture f(6);
+    f.unit->read_start();
+    f.client->read();
+
+    std::stringstream state;
+    f.unit->save_state(state);
+    Card_Read_Fixture restored(0);
+    restored.unit->load_state(state);
+    CHECK(restored.unit->read_hopper_deck() == f.unit->read_hopper_deck());
+    CHECK(restored.unit->read_stacker_deck() == f.unit->read_stacker_deck());
+    CHECK(restored.unit->get_source() == f.unit->get_source());
+    CHECK(!restored.unit->is_read_idle());
+
+    // Both units continue the same way.
+    f.client->read();
+    restored.client->read();
+    CHECK(restored.client->running);
+    f.client->fill_buffer();
+    restored.client->fill_buffer();
+    CHECK(restored.client->buffer == f.client->buffer);
+    CHECK(restored.client->buffer == card_to_buffer(card3));
+
+    std::stringstream truncated(state.str().substr(0, 20));
+    CHECK_THROWS(restored.unit->load_state(truncated));
+    CHECK(restored.unit->read_stacker_deck().size() == 2);
+}
+
+TEST_CASE("reload read hopper")
 { 
     Card_Read_Fixture f;
     f.unit->read_start();
     f.client->read();
-    BOOST_CHECK(f.unit->read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    CHECK(f.unit->read_hopper_deck().empty());
+    CHECK(f.unit->read_stacker_deck().size() == 1);
     f.client->read();
     // Hopper empty, cards don't advance, resume signal not given.
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card2) == f.client->buffer);
-    BOOST_CHECK(!f.client->running);
-    BOOST_CHECK(f.unit->is_read_idle());
-    BOOST_CHECK(!f.unit->is_end_of_file());
+    CHECK(card_to_buffer(card2) == f.client->buffer);
+    CHECK(!f.client->running);
+    CHECK(f.unit->is_read_idle());
+    CHECK(!f.unit->is_end_of_file());
 
     f.unit->load_read_hopper(f.deck);
     f.unit->read_start();
-    BOOST_CHECK(!f.unit->is_read_idle());
+    CHECK(!f.unit->is_read_idle());
     // Cards advance.
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card3) == f.client->buffer);
+    CHECK(card_to_buffer(card3) == f.client->buffer);
     f.client->read();
-    BOOST_CHECK(f.client->running);
+    CHECK(f.client->running);
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card4) == f.client->buffer);
+    CHECK(card_to_buffer(card4) == f.client->buffer);
 }
 
-BOOST_AUTO_TEST_CASE(end_of_file)
+TEST_CASE("end of file")
 {
     Card_Read_Fixture f;
     f.unit->read_start();
@@ -329,69 +511,170 @@ BOOST_AUTO_TEST_CASE(end_of_file)
     f.client->read();
     // Hopper empty, cards don't advance, resume signal not given.
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card2) == f.client->buffer);
-    BOOST_CHECK(!f.client->running);
-    BOOST_CHECK(f.unit->is_read_idle());
+    CHECK(card_to_buffer(card2) == f.client->buffer);
+    CHECK(!f.client->running);
+    CHECK(f.unit->is_read_idle());
+
+    f.unit->end_of_file();
+    f.client->fill_buffer();
+    CHECK(card_to_buffer(card3) == f.client->buffer);
+    CHECK(f.unit->is_end_of_file());
+    f.client->read();
+    f.client->fill_buffer();
+    CHECK(card_to_buffer(card4) == f.client->buffer);
+    // The last card has been read.  The program isn't resumed to read it again.
+    f.client->read();
+    CHECK(!f.client->running);
+}
+
+TEST_CASE("read start without a card at the read station")
+{
+    Card_Read_Fixture f(1);
+    f.unit->read_start();
+    // The card is at the 1st station.
+    CHECK(!f.client->running);
+    f.unit->read_start();
+    CHECK(!f.client->running);
+    f.unit->read_start();
+    CHECK(f.client->running);
+}
+
+TEST_CASE("read hold")
+{
+    Card_Read_Fixture f;
+    CHECK(f.unit->source_hold() == Card_Hold::stopped);
+    f.unit->read_start();
+    f.client->read();
+    f.client->read();
+    CHECK(!f.client->running);
+    // Pressing end of file would read the cards left in the feed.
+    CHECK(f.unit->source_hold() == Card_Hold::end_of_file);
 
     f.unit->end_of_file();
+    f.client->read();
+    f.client->read();
+    f.client->read();
+    CHECK(!f.client->running);
+    CHECK(f.unit->source_hold() == Card_Hold::hopper_empty);
+
+    f.unit->read_stop();
+    CHECK(f.unit->source_hold() == Card_Hold::stopped);
+}
+
+TEST_CASE("streamed read hopper")
+{
+    Card_Read_Fixture f(0);
+    std::size_t n_pulled = 0;
+    f.unit->load_read_hopper([&n_pulled](Card& card) {
+        if (n_pulled == 1000)
+            return false;
+        card = test_cards[n_pulled++ % test_cards.size()];
+        return true;
+    });
+    // Only enough cards for the feed are pulled.
+    CHECK(n_pulled == 3);
+    f.unit->read_start();
+    CHECK(n_pulled == 6);
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card3) == f.client->buffer);
-    BOOST_CHECK(f.unit->is_end_of_file());
+    CHECK(card_to_buffer(card1) == f.client->buffer);
+
+    for (std::size_t i = 1; i <= 997; ++i)
+    {
+        f.client->read();
+        REQUIRE(f.client->running);
+        CHECK(f.unit->read_hopper_deck().size() <= 3);
+    }
+    f.client->fill_buffer();
+    CHECK(card_to_buffer(test_cards[997 % test_cards.size()]) == f.client->buffer);
+    CHECK(f.unit->read_hopper_deck().empty());
+    CHECK(n_pulled == 1000);
+
+    // The reader ran out.  Same as an empty hopper from here.
     f.client->read();
+    CHECK(!f.client->running);
+    CHECK(f.unit->is_read_idle());
+    f.unit->end_of_file();
+    CHECK(f.client->running);
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card4) == f.client->buffer);
+    CHECK(card_to_buffer(test_cards[998 % test_cards.size()]) == f.client->buffer);
 }
 
-BOOST_AUTO_TEST_CASE(read_read_stop)
+TEST_CASE("spilled read stacker")
+{
+    Card_Read_Fixture f(10);
+    f.unit->read_start();
+    f.client->read();
+    f.client->read();
+    CHECK(f.unit->read_stacker_deck().size() == 2);
+
+    // Cards already stacked are spilled too.
+    Card_Deck spilled;
+    f.unit->spill_read_stacker([&spilled](const Card& card) { spilled.push_back(card); }, 1);
+    CHECK(spilled == Card_Deck{card1});
+    CHECK(f.unit->read_stacker_deck() == Card_Deck{card2});
+
+    for (int i = 0; i < 4; ++i)
+        f.client->read();
+    CHECK(spilled == Card_Deck{card1, card2, card3, card4, card1});
+    CHECK(f.unit->read_stacker_deck() == Card_Deck{card2});
+
+    // Keep everything again.
+    f.unit->spill_read_stacker(nullptr);
+    f.client->read();
+    CHECK(spilled.size() == 5);
+    CHECK(f.unit->read_stacker_deck().size() == 2);
+}
+
+TEST_CASE("read read stop")
 {
     Card_Read_Fixture f(8);
     f.unit->read_start();
     f.client->read();
-    BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    CHECK(f.unit->read_hopper_deck().size() == 4);
+    CHECK(f.unit->read_stacker_deck().size() == 1);
     // Either key stops reading and punching.
     f.unit->read_stop();
-    BOOST_CHECK(f.unit->is_read_idle());
-    BOOST_CHECK(!f.unit->is_end_of_file());
+    CHECK(f.unit->is_read_idle());
+    CHECK(!f.unit->is_end_of_file());
     f.client->read();
     // Stopped, cards don't advance, resume signal not given.
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card2) == f.client->buffer);
-    BOOST_CHECK(!f.client->running);
+    CHECK(card_to_buffer(card2) == f.client->buffer);
+    CHECK(!f.client->running);
 
     f.unit->read_start();
-    BOOST_CHECK(!f.unit->is_read_idle());
-    BOOST_CHECK(!f.unit->is_end_of_file());
+    CHECK(!f.unit->is_read_idle());
+    CHECK(!f.unit->is_end_of_file());
     // Cards advance.
-    BOOST_CHECK(f.client->running);
+    CHECK(f.client->running);
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card3) == f.client->buffer);
+    CHECK(card_to_buffer(card3) == f.client->buffer);
     f.client->read();
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card4) == f.client->buffer);
+    CHECK(card_to_buffer(card4) == f.client->buffer);
 }
 
-BOOST_AUTO_TEST_CASE(read_punch_stop)
+TEST_CASE("read punch stop")
 {
     Card_Read_Fixture f(8);
     f.unit->read_start();
     f.client->read();
-    BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    CHECK(f.unit->read_hopper_deck().size() == 4);
+    CHECK(f.unit->read_stacker_deck().size() == 1);
     // Either key stops reading and punching.
     f.unit->punch_stop();
     f.client->read();
-    BOOST_CHECK(!f.client->running);
+    CHECK(!f.client->running);
 
     f.unit->read_start();
-    BOOST_CHECK(!f.unit->is_read_idle());
-    BOOST_CHECK(!f.unit->is_end_of_file());
-    BOOST_CHECK(f.client->running);
+    CHECK(!f.unit->is_read_idle());
+    CHECK(!f.unit->is_end_of_file());
+    CHECK(f.client->running);
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card3) == f.client->buffer);
+    CHECK(card_to_buffer(card3) == f.client->buffer);
     f.client->read();
     f.client->fill_buffer();
-    BOOST_CHECK(card_to_buffer(card4) == f.client->buffer);
+    CHECK(card_to_buffer(card4) == f.client->buffer);
 }
 
 struct Mock_Sink_Client : Sink_Client
@@ -406,8 +689,8 @@ struct Mock_Sink_Client : Sink_Client
         {
             // Transfer to buffer -- no op
             // Write buffer
-            for (; !buffer.empty(); buffer.pop_front())
-                snk->get_sink().push_back(buffer.front());
+            for (const auto& word : buffer)
+                snk->get_sink().push_back(word);
             running = false;
             snk->advance_sink();
         }
@@ -430,134 +713,176 @@ struct Card_Punch_Fixture
     std::shared_ptr<Mock_Sink_Client> client;
 };
 
-BOOST_AUTO_TEST_CASE(punch_run_in_0_cards)
+TEST_CASE("punch run in 0 cards")
 {
     Card_Punch_Fixture f(0);
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 0);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 0);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
     f.unit->punch_start();
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 0);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 0);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
 }
 
-BOOST_AUTO_TEST_CASE(punch_run_in_1_card)
+TEST_CASE("punch run in 1 card")
 {
     Card_Punch_Fixture f(1);
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 1);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 1);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
     f.unit->punch_start();
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 0);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 0);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
 }
 
-BOOST_AUTO_TEST_CASE(punch_run_in)
+TEST_CASE("punch run in")
 {
     Card_Punch_Fixture f;
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 4);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
     f.unit->punch_start();
-    BOOST_CHECK(!f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 2);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(!f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
     f.unit->punch_start();
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 2);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->punch_hopper_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
 }
 
-BOOST_AUTO_TEST_CASE(punch_run_out)
+TEST_CASE("punch run out")
 {
     Card_Punch_Fixture f;
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 4);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
     f.unit->punch_start();
-    BOOST_CHECK(!f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 2);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 0);
+    CHECK(!f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck().size() == 0);
     f.unit->load_punch_hopper(Card_Deck());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 0);
+    CHECK(f.unit->punch_hopper_deck().size() == 0);
     f.unit->punch_start();
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 1);
+    CHECK(f.unit->punch_stacker_deck().size() == 1);
     f.unit->punch_start();
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 2);
+    CHECK(f.unit->punch_stacker_deck().size() == 2);
+}
+
+TEST_CASE("punch hold")
+{
+    Card_Punch_Fixture f;
+    CHECK(f.unit->sink_hold() == Card_Hold::stopped);
+    f.unit->load_punch_hopper(Card_Deck());
+    CHECK(f.unit->sink_hold() == Card_Hold::hopper_empty);
 }
 
-BOOST_AUTO_TEST_CASE(punch_instruction)
+TEST_CASE("punch instruction")
 {
     Card_Punch_Fixture f;
     f.unit->punch_start();
     f.client->write(card_to_buffer(card1));
-    BOOST_CHECK(!f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 1);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 1);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card1);
+    CHECK(!f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 1);
+    CHECK(f.unit->punch_stacker_deck().size() == 1);
+    CHECK(f.unit->punch_stacker_deck().back() == card1);
+}
+
+TEST_CASE("streamed punch stacker")
+{
+    Card_Punch_Fixture f;
+    Card_Deck punched;
+    f.unit->spill_punch_stacker([&punched](const Card& card) { punched.push_back(card); });
+    f.unit->punch_start();
+    f.client->write(card_to_buffer(card1));
+    // The card is passed on as soon as it's stacked.
+    CHECK(punched == Card_Deck{card1});
+    CHECK(f.unit->punch_stacker_deck().empty());
+    f.client->write(card_to_buffer(card2));
+    CHECK(punched == Card_Deck{card1, card2});
+}
+
+TEST_CASE("flush spilled stackers")
+{
+    Card_Punch_Fixture f;
+    int n_flushes = 0;
+    f.unit->spill_punch_stacker([](const Card&) {}, 0, [&n_flushes] { ++n_flushes; });
+    f.unit->punch_start();
+    f.client->write(card_to_buffer(card1));
+    CHECK(n_flushes == 0);
+    f.unit->punch_stop();
+    CHECK(n_flushes == 1);
+
+    // Running out of cards stops the punch.
+    f.unit->punch_start();
+    f.client->write(card_to_buffer(card2));
+    f.client->write(card_to_buffer(card3));
+    CHECK(f.unit->is_punch_idle());
+    CHECK(n_flushes == 2);
 }
 
-BOOST_AUTO_TEST_CASE(reload_punch_hopper)
+TEST_CASE("reload punch hopper")
 {
     Card_Punch_Fixture f(4);
     f.unit->punch_start();
     f.client->write(card_to_buffer(card1));
     f.client->write(card_to_buffer(card2));
     f.client->write(card_to_buffer(card3));
-    BOOST_CHECK(!f.client->running);
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 0);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 2);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card2);
+    CHECK(!f.client->running);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 0);
+    CHECK(f.unit->punch_stacker_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck().back() == card2);
     f.unit->load_punch_hopper(Card_Deck(2));
     f.unit->punch_start();
-    // Does nothing with 2 cards in the unit and any in the hopper.
-    BOOST_CHECK(f.client->running);
-    BOOST_CHECK(!f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 2);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 2);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card2);
+    // The third punch was held for lack of cards.  Like after punch stop, it's completed and
+    // its card is stacked when punching is started again.
+    CHECK(f.client->running);
+    CHECK(!f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 1);
+    CHECK(f.unit->punch_stacker_deck().size() == 3);
+    CHECK(f.unit->punch_stacker_deck().back() == card3);
 }
 
-BOOST_AUTO_TEST_CASE(punch_punch_stop)
+TEST_CASE("punch punch stop")
 {
     Card_Punch_Fixture f(8);
     f.unit->punch_start();
     f.client->write(card_to_buffer(card1));
     f.unit->punch_stop();
-    BOOST_CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->is_punch_idle());
     f.client->write(card_to_buffer(card2));
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 5);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 1);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card1);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 5);
+    CHECK(f.unit->punch_stacker_deck().size() == 1);
+    CHECK(f.unit->punch_stacker_deck().back() == card1);
 
     f.unit->punch_start();
-    BOOST_CHECK(!f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 2);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card2);
+    CHECK(!f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 4);
+    CHECK(f.unit->punch_stacker_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck().back() == card2);
 }
 
-BOOST_AUTO_TEST_CASE(punch_read_stop)
+TEST_CASE("punch read stop")
 {
     Card_Punch_Fixture f(8);
     f.unit->punch_start();
     f.client->write(card_to_buffer(card1));
     f.unit->read_stop();
-    BOOST_CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->is_punch_idle());
     f.client->write(card_to_buffer(card2));
-    BOOST_CHECK(f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 5);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 1);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card1);
+    CHECK(f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 5);
+    CHECK(f.unit->punch_stacker_deck().size() == 1);
+    CHECK(f.unit->punch_stacker_deck().back() == card1);
 
     f.unit->punch_start();
-    BOOST_CHECK(!f.unit->is_punch_idle());
-    BOOST_CHECK_EQUAL(f.unit->punch_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->punch_stacker_deck().size(), 2);
-    BOOST_CHECK(f.unit->punch_stacker_deck().back() == card2);
+    CHECK(!f.unit->is_punch_idle());
+    CHECK(f.unit->punch_hopper_deck().size() == 4);
+    CHECK(f.unit->punch_stacker_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck().back() == card2);
 }
 
 }
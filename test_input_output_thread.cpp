@@ -0,0 +1,182 @@
+#include "input_output_thread.hpp"
+#include "doctest.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+using namespace IBM533;
+using namespace IBM650;
+
+namespace
+{
+/// @Return a card with n in the units digit of each word.
+Card numbered_card(TDigit n)
+{
+    Buffer buffer(buffer_size, Word({0,0, 0,0,0,0, 0,0,0,n, '+'}));
+    return buffer_to_card(buffer);
+}
+
+struct Thread_Client : Source_Client, Sink_Client
+{
+    virtual void connect_source(std::weak_ptr<Source> src) override { source = src; }
+    virtual void resume_source_client() override {
+        read_running = true;
+        buffer = source.lock()->get_source();
+    }
+    virtual void connect_sink(std::weak_ptr<Sink> snk) override { sink = snk; }
+    virtual void resume_sink_client() override { punch_running = true; }
+
+    std::weak_ptr<Source> source;
+    std::weak_ptr<Sink> sink;
+    Buffer buffer;
+    bool read_running = false;
+    bool punch_running = false;
+};
+
+struct Thread_Fixture
+{
+    Thread_Fixture()
+        : io(std::make_shared<Input_Output_Thread>(std::make_shared<Input_Output_Unit>())),
+          client(std::make_shared<Thread_Client>())
+        {
+            io->connect_source_client(client);
+            io->connect_sink_client(client);
+            client->connect_source(io);
+            client->connect_sink(io);
+        }
+
+    /// Poll until the flag is set or a second passes.
+    bool wait_for(const bool& flag) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (!flag && std::chrono::steady_clock::now() < end)
+            io->poll();
+        return flag;
+    }
+
+    std::shared_ptr<Input_Output_Thread> io;
+    std::shared_ptr<Thread_Client> client;
+};
+}
+
+TEST_CASE("threaded read")
+{
+    Thread_Fixture f;
+    f.io->operate([](Input_Output_Unit& unit) {
+        unit.load_read_hopper({numbered_card(1), numbered_card(2), numbered_card(3),
+                               numbered_card(4)});
+        unit.read_start();
+    }).wait();
+    // Nothing is delivered until the client polls.
+    CHECK(!f.client->read_running);
+    REQUIRE(f.wait_for(f.client->read_running));
+    CHECK(f.client->buffer == card_to_buffer(numbered_card(1)));
+
+    f.client->read_running = false;
+    f.io->advance_source();
+    REQUIRE(f.wait_for(f.client->read_running));
+    CHECK(f.client->buffer == card_to_buffer(numbered_card(2)));
+
+    // The hopper is empty.  The advance is ignored until more cards are loaded.
+    f.client->read_running = false;
+    f.io->advance_source();
+    CHECK(!f.wait_for(f.client->read_running));
+    f.io->operate([](Input_Output_Unit& unit) {
+        unit.load_read_hopper({numbered_card(5)});
+        unit.read_start();
+    }).wait();
+    REQUIRE(f.wait_for(f.client->read_running));
+    CHECK(f.client->buffer == card_to_buffer(numbered_card(3)));
+}
+
+TEST_CASE("threaded punch")
+{
+    Thread_Fixture f;
+    f.io->operate([](Input_Output_Unit& unit) {
+        unit.load_punch_hopper(Card_Deck(4));
+        unit.punch_start();
+    }).wait();
+    REQUIRE(f.wait_for(f.client->punch_running));
+
+    for (TDigit n = 1; n <= 2; ++n)
+    {
+        f.client->punch_running = false;
+        f.io->get_sink() = card_to_buffer(numbered_card(n));
+        f.io->advance_sink();
+        CHECK(f.io->get_sink().empty());
+        f.wait_for(f.client->punch_running);
+    }
+
+    Card_Deck punched;
+    f.io->operate([&punched](Input_Output_Unit& unit) {
+        punched = unit.punch_stacker_deck();
+    }).wait();
+    REQUIRE(punched.size() == 2);
+    CHECK(punched[0] == numbered_card(1));
+    CHECK(punched[1] == numbered_card(2));
+}
+
+TEST_CASE("more resumes than fit in the queue")
+{
+    Thread_Fixture f;
+    f.io->operate([](Input_Output_Unit& unit) {
+        unit.load_read_hopper(Card_Deck(20, numbered_card(1)));
+        // Each press resumes the client while there's a card at the read station.  More
+        // than the queue holds are merged.
+        for (int i = 0; i < 20; ++i)
+            unit.read_start();
+    }).wait();
+    CHECK(f.io->poll());
+    CHECK(f.client->read_running);
+    CHECK(!f.io->poll());
+}
+
+TEST_CASE("advancing without waiting")
+{
+    Thread_Fixture f;
+    // The unit is stopped, so it takes the requests but never resumes the client.  The
+    // queue fills up when the unit's thread is slow to drain it, so block the thread.
+    std::promise<void> started;
+    std::promise<void> release;
+    auto blocked = release.get_future().share();
+    f.io->operate([&started, blocked](Input_Output_Unit&) {
+        started.set_value();
+        blocked.wait();
+    });
+    started.get_future().wait();
+    CHECK_THROWS_AS(for (int i = 0; i < 20; ++i) f.io->advance_source(), std::runtime_error);
+    release.set_value();
+}
+
+TEST_CASE("unit throws on its thread")
+{
+    Thread_Fixture f;
+    f.io->operate([](Input_Output_Unit& unit) {
+        unit.spill_punch_stacker([](const Card&) { throw std::runtime_error("disk full"); });
+        unit.load_punch_hopper(Card_Deck(4));
+        unit.punch_start();
+    }).wait();
+    REQUIRE(f.wait_for(f.client->punch_running));
+
+    // Stacking the punched card throws.  The client gets the exception when it polls.
+    f.io->get_sink() = card_to_buffer(numbered_card(1));
+    f.io->advance_sink();
+    bool thrown = false;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!thrown && std::chrono::steady_clock::now() < end)
+    {
+        try
+        {
+            f.io->poll();
+        }
+        catch (const std::runtime_error& e)
+        {
+            CHECK(std::string(e.what()) == "disk full");
+            thrown = true;
+        }
+    }
+    CHECK(thrown);
+    // And with every request after that.
+    CHECK_THROWS_AS(f.io->advance_sink(), std::runtime_error);
+    CHECK_THROWS_AS(f.io->poll(), std::runtime_error);
+}
@@ -0,0 +1,361 @@
+#include "job.hpp"
+#include "doctest.h"
+
+#include <algorithm>
+#include <future>
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+// Reset and add 1158 into lower, then stop.  Same as the optimum RAL timing test.
+Job ral_job()
+{
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,5, '+'});
+    job.drum = {{Address({0,0,0,5}), Word({6,5, 1,1,5,8, 0,0,1,3, '+'})},
+                {Address({0,0,1,3}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'})},
+                {Address({1,1,5,8}), Word({0,0, 0,1,1,2, 2,3,3,4, '-'})}};
+    return job;
+}
+
+// Add 0100000000 to upper until it overflows.
+Job overflow_job()
+{
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,5, '+'});
+    job.drum = {{Address({0,0,0,5}), Word({1,0, 1,1,5,8, 0,0,0,5, '+'})},
+                {Address({1,1,5,8}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'})}};
+    return job;
+}
+
+// No-op that branches to itself.
+Job loop_job()
+{
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,5, '+'});
+    job.drum = {{Address({0,0,0,5}), Word({0,0, 0,0,0,0, 0,0,0,5, '+'})}};
+    return job;
+}
+
+/// @Return a card with n in the low digits of each word.
+IBM533::Card numbered_card(int n)
+{
+    Buffer buffer(IBM533::buffer_size,
+                  Word({0,0, 0,0,0,0, 0,0, TDigit(n/10%10), TDigit(n%10), '+'}));
+    return IBM533::buffer_to_card(buffer);
+}
+
+// Read cards into 0001-0010 until they run out.
+Job reading_job(int n_cards)
+{
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,5,0, '+'});
+    job.drum = {{Address({0,0,5,0}), Word({7,0, 0,0,0,0, 0,0,5,0, '+'})}};
+    for (int i = 1; i <= n_cards; ++i)
+        job.deck.push_back(numbered_card(i));
+    return job;
+}
+
+// Punch 0027-0034 forever.
+Job punching_job()
+{
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,5,0, '+'});
+    job.drum = {{Address({0,0,5,0}), Word({7,1, 0,0,0,0, 0,0,5,0, '+'})}};
+    for (Address address({0,0,2,7}); address != Address({0,0,3,7}); ++address)
+        job.drum.emplace_back(address, Word({0,0, 0,0,0,0, 0,0,4,2, '+'}));
+    return job;
+}
+
+// Word times for card cycles.
+constexpr TTime read_cycle_word_times = 300000/96;
+constexpr TTime punch_cycle_word_times = 600000/96;
+}
+
+TEST_CASE("run job")
+{
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto result = run_job(computer, ral_job(), 1000);
+    CHECK(result.status == Job_Result::Status::stopped);
+    CHECK(result.run_time == 17);
+    CHECK(result.lower == Word({0,0, 0,1,1,2, 2,3,3,4, '-'}));
+    CHECK(result.upper == Word({0,0, 0,0,0,0, 0,0,0,0, '-'}));
+    CHECK(result.drum.size() == 3);
+}
+
+TEST_CASE("job quota")
+{
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto result = run_job(computer, loop_job(), 1000);
+    CHECK(result.status == Job_Result::Status::quota_exceeded);
+    CHECK(result.run_time >= 1000);
+    // Stopped between instructions.
+    CHECK(computer->instruction_address());
+}
+
+TEST_CASE("job with card input")
+{
+    // The job has no cards, so a read can't finish.
+    Job job;
+    job.storage_entry = Word({7,0, 0,0,0,0, 0,0,0,5, '+'});
+    job.drum = {{Address({0,0,0,5}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'})}};
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto result = run_job(computer, job, 1000);
+    CHECK(result.status == Job_Result::Status::card_wait);
+}
+
+TEST_CASE("job error stop")
+{
+    // Branch on 8 in position 10 of a zero distributor.  A digit other than 8 or 9 stops
+    // the program.
+    Job job;
+    job.storage_entry = Word({9,0, 0,0,0,0, 0,0,0,5, '+'});
+    job.drum = {{Address({0,0,0,5}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'})}};
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto result = run_job(computer, job, 1000);
+    CHECK(result.status == Job_Result::Status::error);
+    CHECK(result.run_time < 100);
+}
+
+TEST_CASE("stop requested during a job")
+{
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto unit = std::make_shared<IBM533::Input_Output_Unit>();
+    start_job(computer, unit, loop_job());
+    Job_Result::Status status;
+    CHECK(!continue_job(*computer, *unit, 100, status));
+    computer->program_stop();
+    CHECK(continue_job(*computer, *unit, 1000, status));
+    CHECK(status == Job_Result::Status::stopped);
+    CHECK(computer->run_time() < 200);
+}
+
+TEST_CASE("pooled computers are reset")
+{
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    run_job(computer, loop_job(), 1001);
+    pool.release(std::move(computer));
+    CHECK(pool.size() == 1);
+    computer = pool.acquire();
+    CHECK(pool.size() == 0);
+    CHECK(computer->is_ready());
+    CHECK(computer->get_drum(Address({0,0,0,5})).is_blank());
+    // The drum position doesn't carry over.
+    CHECK(run_job(computer, ral_job(), 1000).run_time == 17);
+}
+
+TEST_CASE("job text format")
+{
+    auto job = ral_job();
+    job.priority = 3;
+    // Limits past the range of a 32-bit int are kept.
+    job.word_time_limit = 5'000'000'000;
+    std::stringstream ss;
+    write_job(ss, job);
+    auto read = read_job(ss);
+    CHECK(read.priority == 3);
+    CHECK(read.word_time_limit == 5'000'000'000);
+    CHECK(read.storage_entry == job.storage_entry);
+    REQUIRE(read.drum.size() == job.drum.size());
+    for (std::size_t i = 0; i < job.drum.size(); ++i)
+    {
+        CHECK(read.drum[i].first == job.drum[i].first);
+        CHECK(read.drum[i].second == job.drum[i].second);
+    }
+
+    std::istringstream bad("entry 12345+\nrun\n");
+    CHECK_THROWS(read_job(bad));
+    std::istringstream unterminated("priority 1\n");
+    CHECK_THROWS(read_job(unterminated));
+    std::stringstream deck;
+    write_job(deck, reading_job(3));
+    CHECK(read_job(deck).deck == reading_job(3).deck);
+
+    std::istringstream off_the_drum("entry 0000000000+\ndrum 9999 0000000000+\nrun\n");
+    CHECK_THROWS_AS(read_job(off_the_drum), std::runtime_error);
+}
+
+TEST_CASE("result text format")
+{
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto result = run_job(computer, ral_job(), 1000);
+    std::stringstream ss;
+    write_result(ss, result);
+    auto read = read_result(ss);
+    CHECK(read.status == result.status);
+    CHECK(read.run_time == result.run_time);
+    CHECK(read.distributor == result.distributor);
+    CHECK(read.upper == result.upper);
+    CHECK(read.lower == result.lower);
+    CHECK(read.address == result.address);
+    CHECK(read.drum.size() == result.drum.size());
+
+    result.punched = {numbered_card(1), IBM533::Card{}};
+    std::stringstream punched;
+    write_result(punched, result);
+    CHECK(read_result(punched).punched == result.punched);
+
+    // Run times past the range of a 32-bit int are kept.
+    result.run_time = 5'000'000'000;
+    std::stringstream long_run;
+    write_result(long_run, result);
+    CHECK(read_result(long_run).run_time == 5'000'000'000);
+}
+
+TEST_CASE("job queue order")
+{
+    Job_Queue queue;
+    auto push = [&queue](int priority, int limit) {
+        Job job;
+        job.priority = priority;
+        job.word_time_limit = limit;
+        queue.push(job, nullptr);
+    };
+    push(0, 1);
+    push(5, 2);
+    push(0, 3);
+    push(5, 4);
+    queue.close();
+
+    std::vector<int> order;
+    Job_Queue::Entry entry;
+    while (queue.pop(entry))
+        order.push_back(entry.job.word_time_limit);
+    CHECK(order == std::vector<int>{2, 4, 1, 3});
+}
+
+TEST_CASE("job server")
+{
+    Job_Server server(2, 5000);
+    std::promise<Job_Result> ral;
+    std::promise<Job_Result> loop;
+    server.submit(ral_job(), [&ral](const Job_Result& r) { ral.set_value(r); });
+    // The server's quota applies when the job doesn't set a limit.
+    server.submit(loop_job(), [&loop](const Job_Result& r) { loop.set_value(r); });
+    auto ral_result = ral.get_future().get();
+    auto loop_result = loop.get_future().get();
+    CHECK(ral_result.status == Job_Result::Status::stopped);
+    CHECK(ral_result.run_time == 17);
+    CHECK(loop_result.status == Job_Result::Status::quota_exceeded);
+    CHECK(loop_result.run_time < 5010);
+}
+
+TEST_CASE("bad job on the server")
+{
+    Job_Server server(1, 5000);
+    auto bad = ral_job();
+    bad.drum.emplace_back(Address({9,9,9,9}), Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+    std::promise<Job_Result> bad_result;
+    std::promise<Job_Result> good_result;
+    server.submit(bad, [&bad_result](const Job_Result& r) { bad_result.set_value(r); });
+    server.submit(ral_job(), [&good_result](const Job_Result& r) { good_result.set_value(r); });
+    auto result = bad_result.get_future().get();
+    CHECK(result.status == Job_Result::Status::failed);
+    CHECK(result.message == "not a drum address: 9999");
+    // The server goes on with the next job.
+    CHECK(good_result.get_future().get().status == Job_Result::Status::stopped);
+
+    // The message is kept in the text format.
+    std::stringstream ss;
+    write_result(ss, result);
+    CHECK(read_result(ss).message == result.message);
+
+    Computer_Pool pool;
+    CHECK_THROWS_AS(start_job(pool.acquire(), std::make_shared<IBM533::Input_Output_Unit>(),
+                              Job()),
+                    std::runtime_error);
+}
+
+TEST_CASE("preempted jobs give the same results")
+{
+    Computer_Pool pool;
+    auto computer = pool.acquire();
+    auto expected = run_job(computer, overflow_job(), 1'000'000);
+    REQUIRE(expected.status == Job_Result::Status::overflow);
+    // Enough word times for several slices.
+    REQUIRE(expected.run_time > 1000);
+
+    std::promise<Job_Result> sliced;
+    std::promise<Job_Result> short_job;
+    {
+        Job_Server server(1, 1'000'000, 100);
+        server.submit(overflow_job(), [&sliced](const Job_Result& r) { sliced.set_value(r); });
+        server.submit(ral_job(), [&short_job](const Job_Result& r) { short_job.set_value(r); });
+    }
+    auto result = sliced.get_future().get();
+    CHECK(result.status == expected.status);
+    CHECK(result.run_time == expected.run_time);
+    CHECK(result.upper == expected.upper);
+    CHECK(result.lower == expected.lower);
+    CHECK(result.distributor == expected.distributor);
+    CHECK(result.address == expected.address);
+    CHECK(short_job.get_future().get().run_time == 17);
+}
+
+TEST_CASE("job reads its deck")
+{
+    Computer_Pool pool;
+    // Decks shorter than the read feed and longer.
+    for (int n_cards : {1, 2, 5})
+    {
+        auto result = run_job(pool.acquire(), reading_job(n_cards), 1'000'000);
+        // All of the cards are read, including the ones left in the feed when the hopper
+        // empties.  Then the program waits for more.
+        CHECK(result.status == Job_Result::Status::card_wait);
+        auto last = std::find_if(result.drum.begin(), result.drum.end(),
+                                 [](const auto& w) { return w.first == Address({0,0,0,1}); });
+        REQUIRE(last != result.drum.end());
+        CHECK(last->second == Word({0,0, 0,0,0,0, 0,0,0,TDigit(n_cards), '+'}));
+        // Each read after the first waits for a card cycle.  A card read twice would take
+        // another.
+        CHECK(result.run_time < n_cards*read_cycle_word_times);
+        CHECK(result.punched.empty());
+    }
+}
+
+TEST_CASE("job punches cards")
+{
+    Computer_Pool pool;
+    // Enough time for more punches than the blank cards put in the hopper at once.
+    auto result = run_job(pool.acquire(), punching_job(), 25*punch_cycle_word_times);
+    CHECK(result.status == Job_Result::Status::quota_exceeded);
+    CHECK(result.punched.size() >= 24);
+    Buffer expected(IBM533::buffer_size, Word({0,0, 0,0,0,0, 0,0,4,2, '+'}));
+    expected[8] = Word({0,0, 0,0,0,0, 0,0,0,0, '+'});
+    expected[9] = expected[8];
+    for (const auto& card : result.punched)
+        CHECK(IBM533::card_to_buffer(card) == expected);
+}
+
+TEST_CASE("preempted card jobs give the same results")
+{
+    Computer_Pool pool;
+    auto limit = 25*punch_cycle_word_times;
+    auto expected_read = run_job(pool.acquire(), reading_job(8), limit);
+    auto expected_punch = run_job(pool.acquire(), punching_job(), limit);
+
+    std::promise<Job_Result> read;
+    std::promise<Job_Result> punch;
+    {
+        // Slices much shorter than card cycles, so jobs are checkpointed while cards move.
+        Job_Server server(1, limit, 1000);
+        server.submit(reading_job(8), [&read](const Job_Result& r) { read.set_value(r); });
+        server.submit(punching_job(), [&punch](const Job_Result& r) { punch.set_value(r); });
+    }
+    auto read_result = read.get_future().get();
+    CHECK(read_result.status == expected_read.status);
+    CHECK(read_result.run_time == expected_read.run_time);
+    CHECK(read_result.drum == expected_read.drum);
+    auto punch_result = punch.get_future().get();
+    CHECK(punch_result.status == expected_punch.status);
+    CHECK(punch_result.punched == expected_punch.punched);
+}
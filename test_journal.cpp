@@ -0,0 +1,136 @@
+#include "journal.hpp"
+#include "doctest.h"
+
+#include <sstream>
+
+using namespace IBM650;
+using namespace IBM533;
+
+namespace
+{
+Event event(Event::Type type, int value = 0)
+{
+    Event e;
+    e.type = type;
+    e.value = value;
+    return e;
+}
+
+/// A session at the console: power up, run the RAL test program in half-cycle steps, and
+/// load some cards.
+void operate(Journal_Recorder& recorder)
+{
+    recorder.apply(event(Event::Type::power_on));
+    recorder.apply(event(Event::Type::step, 180));
+    auto entry = event(Event::Type::set_storage_entry);
+    entry.word = Word({0,0, 0,0,0,0, 0,0,0,5, '+'});
+    recorder.apply(entry);
+    recorder.apply(event(Event::Type::set_programmed_mode,
+                         int(Computer::Programmed_Mode::stop)));
+    recorder.apply(event(Event::Type::set_control_mode, int(Computer::Control_Mode::run)));
+    recorder.apply(event(Event::Type::set_half_cycle_mode,
+                         int(Computer::Half_Cycle_Mode::half)));
+    recorder.apply(event(Event::Type::computer_reset));
+    for (int i = 0; i < 3; ++i)
+        recorder.apply(event(Event::Type::program_start));
+    recorder.apply(event(Event::Type::set_half_cycle_mode,
+                         int(Computer::Half_Cycle_Mode::run)));
+    recorder.apply(event(Event::Type::program_start));
+
+    auto cards = event(Event::Type::load_read_hopper);
+    Card card{};
+    card[0] = 1;
+    cards.deck = {card, card, card};
+    recorder.apply(cards);
+    recorder.apply(event(Event::Type::read_start));
+
+    // A stop pressed between runs stops the next one before it starts.
+    recorder.apply(event(Event::Type::program_stop));
+    recorder.apply(event(Event::Type::run_for, 100));
+    recorder.apply(event(Event::Type::program_reset));
+    recorder.apply(event(Event::Type::run_for, 100));
+}
+
+std::string state(const Computer& computer, const Input_Output_Unit& unit)
+{
+    std::ostringstream os;
+    computer.save_state(os);
+    unit.save_state(os);
+    return os.str();
+}
+
+struct Journal_Fixture
+{
+    Journal_Fixture() {
+        computer.set_drum(Address({0,0,0,5}), Word({6,5, 1,1,5,8, 0,0,1,3, '+'}));
+        computer.set_drum(Address({0,0,1,3}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'}));
+        computer.set_drum(Address({1,1,5,8}), Word({0,0, 0,1,1,2, 2,3,3,4, '-'}));
+        Journal_Recorder recorder(computer, unit, journal);
+        operate(recorder);
+    }
+
+    Computer computer;
+    Input_Output_Unit unit;
+    std::stringstream journal;
+};
+}
+
+TEST_CASE("record and replay")
+{
+    Journal_Fixture f;
+    CHECK(f.computer.run_time() > 0);
+    CHECK(f.unit.read_hopper_deck().size() < 3);
+
+    // The replay starts from new machines and ends in the same state.
+    Computer computer;
+    Input_Output_Unit unit;
+    Journal_Player player(computer, unit, f.journal);
+    player.run();
+    CHECK(state(computer, unit) == state(f.computer, f.unit));
+    CHECK(!player.step());
+}
+
+TEST_CASE("replay that goes differently")
+{
+    Journal_Fixture f;
+    Computer computer;
+    Input_Output_Unit unit;
+    Journal_Player player(computer, unit, f.journal);
+    // Change the program after the snapshot.  A no-op before the stop makes it stop later,
+    // so the next event is at a different word time.
+    for (int i = 0; i < 10; ++i)
+        player.step();
+    computer.set_drum(Address({0,0,1,3}), Word({0,0, 0,0,0,0, 0,0,1,4, '+'}));
+    computer.set_drum(Address({0,0,1,4}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'}));
+    CHECK_THROWS(player.run());
+}
+
+TEST_CASE("streamed read hopper isn't journaled")
+{
+    Computer computer;
+    Input_Output_Unit unit;
+    std::stringstream journal;
+    Journal_Recorder recorder(computer, unit, journal);
+    recorder.apply(event(Event::Type::power_on));
+    unit.load_read_hopper([](Card&) { return false; });
+    CHECK_THROWS_AS(recorder.apply(event(Event::Type::read_start)), std::runtime_error);
+    CHECK_THROWS_AS(Journal_Recorder(computer, unit, journal), std::runtime_error);
+
+    unit.load_read_hopper(Card_Deck());
+    recorder.apply(event(Event::Type::read_start));
+}
+
+TEST_CASE("bad journal")
+{
+    Computer computer;
+    Input_Output_Unit unit;
+    std::stringstream not_a_journal("I650");
+    CHECK_THROWS(Journal_Player(computer, unit, not_a_journal));
+
+    Journal_Fixture f;
+    auto truncated = f.journal.str();
+    truncated.resize(truncated.size() - 3);
+    std::stringstream truncated_journal(truncated);
+    Journal_Player player(computer, unit, truncated_journal);
+    CHECK_THROWS(player.run());
+}
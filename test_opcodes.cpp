@@ -1,7 +1,9 @@
 #include "computer.hpp"
+#include "input_output_unit.hpp"
 #include "test_fixture.hpp"
 #include "doctest.h"
 
+using namespace IBM533;
 using namespace IBM650;
 
 struct Opcode_Fixture : Computer_Ready_Fixture
@@ -2257,3 +2259,184 @@ TEST_CASE("table lookup 4")
     // Can't match at address 0248 or 0249.
     CHECK(f.lower() == Word({6,5, 0,2,5,0, 0,5,5,4, '+'}));
 }
+
+struct Card_Fixture
+{
+    /// Connect a ready computer to a card unit and load a program.  The program starts at
+    /// 0050 and runs the instructions in order, and then stops.
+    Card_Fixture(const std::vector<Word>& program)
+        : computer(std::make_shared<Computer>()),
+          unit(std::make_shared<Input_Output_Unit>())
+        {
+            computer->power_on();
+            computer->step(180);
+            unit->connect_source_client(computer);
+            unit->connect_sink_client(computer);
+            computer->connect_source(unit);
+            computer->connect_sink(unit);
+
+            Address addr({0,0,5,0});
+            for (auto instr : program)
+            {
+                auto next = addr;
+                ++next;
+                instr.load(next, 0, 6);
+                computer->set_drum(addr, instr);
+                addr = next;
+            }
+            computer->set_drum(addr, Word({0,1, 0,0,0,0, 0,0,0,0, '+'}));
+            computer->set_storage_entry(Word({0,0, 0,0,0,0, 0,0,5,0, '+'}));
+            computer->set_programmed_mode(Computer::Programmed_Mode::stop);
+            computer->set_control_mode(Computer::Control_Mode::run);
+            computer->computer_reset();
+        }
+
+    std::shared_ptr<Computer> computer;
+    std::shared_ptr<Input_Output_Unit> unit;
+};
+
+/// @Return a card with n in the units digit of each word.
+Card numbered_card(TDigit n)
+{
+    Buffer buffer(buffer_size, Word({0,0, 0,0,0,0, 0,0,0,n, '+'}));
+    return buffer_to_card(buffer);
+}
+
+const Word read_0000({7,0, 0,0,0,0, 0,0,0,0, '+'});
+const Word read_0100({7,0, 0,1,0,0, 0,0,0,0, '+'});
+const Word punch_0000({7,1, 0,0,0,0, 0,0,0,0, '+'});
+const Word punch_0100({7,1, 0,1,0,0, 0,0,0,0, '+'});
+// Time for a card cycle.
+const TTime read_cycle_word_times = 300000/96;
+const TTime punch_cycle_word_times = 600000/96;
+
+// 70  RD  Read
+TEST_CASE("read a card")
+{
+    Card_Fixture f({read_0000});
+    f.unit->load_read_hopper({numbered_card(1), numbered_card(2), numbered_card(3),
+                              numbered_card(4)});
+    f.unit->read_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    Address addr({0,0,0,1});
+    for (int i = 0; i < 8; ++i, ++addr)
+        CHECK(f.computer->get_drum(addr) == Word({0,0, 0,0,0,0, 0,0,0,1, '+'}));
+    CHECK(f.computer->get_drum(Address({0,0,0,9})) == zero);
+    CHECK(f.computer->get_drum(Address({0,0,1,0})) == zero);
+    // Computing overlaps the read cycle.  The stop doesn't wait for it.
+    CHECK(f.computer->run_time() < 200);
+    CHECK(f.unit->read_stacker_deck().size() == 1);
+}
+
+TEST_CASE("read band")
+{
+    // Data address 0100 reads into 0101-0110.
+    Card_Fixture f({read_0100});
+    f.unit->load_read_hopper({numbered_card(7), numbered_card(8), numbered_card(9)});
+    f.unit->read_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    CHECK(f.computer->get_drum(Address({0,1,0,1})) == Word({0,0, 0,0,0,0, 0,0,0,7, '+'}));
+    CHECK(f.computer->get_drum(Address({0,1,0,8})) == Word({0,0, 0,0,0,0, 0,0,0,7, '+'}));
+    CHECK(f.computer->get_drum(Address({0,0,0,1})).is_blank());
+}
+
+TEST_CASE("read interlock")
+{
+    Card_Fixture f({read_0000, read_0100});
+    f.unit->load_read_hopper({numbered_card(1), numbered_card(2), numbered_card(3),
+                              numbered_card(4)});
+    f.unit->read_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    CHECK(f.computer->get_drum(Address({0,1,0,1})) == Word({0,0, 0,0,0,0, 0,0,0,2, '+'}));
+    // The second read waits for the card cycle started by the first.
+    CHECK(f.computer->run_time() >= read_cycle_word_times);
+    CHECK(f.computer->run_time() < read_cycle_word_times + 200);
+}
+
+TEST_CASE("wait for cards")
+{
+    Card_Fixture f({read_0000});
+    // The reader hasn't been started.
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::card_wait);
+    auto t = f.computer->run_time();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::card_wait);
+    CHECK(f.computer->run_time() == t);
+
+    f.unit->load_read_hopper({numbered_card(5), numbered_card(6), numbered_card(7)});
+    f.unit->read_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    CHECK(f.computer->get_drum(Address({0,0,0,1})) == Word({0,0, 0,0,0,0, 0,0,0,5, '+'}));
+}
+
+TEST_CASE("read interlock stalls")
+{
+    Card_Fixture f({read_0000, read_0100});
+    f.unit->load_read_hopper({numbered_card(1), numbered_card(2), numbered_card(3),
+                              numbered_card(4)});
+    f.unit->read_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    const auto& stalls = f.computer->card_stalls();
+    // Only the second read waits for a card cycle.
+    CHECK(stalls.read.interlock.n_waits == 1);
+    CHECK(stalls.read.interlock.word_times > read_cycle_word_times - 200);
+    CHECK(stalls.read.interlock.word_times <= read_cycle_word_times);
+    // 3125 word times is in the bucket for 2048-4095.
+    CHECK(stalls.read.interlock.histogram[12] == 1);
+    CHECK(stalls.punch.interlock.n_waits == 0);
+    REQUIRE(stalls.by_address.size() == 1);
+    CHECK(stalls.by_address.begin()->first == 51);
+    CHECK(stalls.by_address.begin()->second.interlock.word_times
+          == stalls.read.interlock.word_times);
+
+    f.computer->program_reset();
+    CHECK(f.computer->card_stalls().read.interlock.n_waits == 0);
+    CHECK(f.computer->card_stalls().by_address.empty());
+}
+
+TEST_CASE("card hold stalls")
+{
+    Card_Fixture f({read_0000});
+    CHECK(f.computer->run_for(1000) == Computer::Run_Status::card_wait);
+    CHECK(f.computer->run_for(1000) == Computer::Run_Status::card_wait);
+    // The wait isn't counted until it's over.
+    CHECK(f.computer->card_stalls().read.held[std::size_t(Card_Hold::stopped)].n_waits == 0);
+
+    f.unit->load_read_hopper({numbered_card(5), numbered_card(6), numbered_card(7)});
+    f.unit->read_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    const auto& held = f.computer->card_stalls().read.held[std::size_t(Card_Hold::stopped)];
+    CHECK(held.n_waits == 1);
+    // The held time is what the runs were asked for less the instruction half cycle.
+    CHECK(held.word_times > 1900);
+    CHECK(held.word_times < 2000);
+    CHECK(held.histogram[11] == 1);
+    REQUIRE(f.computer->card_stalls().by_address.count(50) == 1);
+    CHECK(f.computer->card_stalls().by_address.at(50).held[std::size_t(Card_Hold::stopped)]
+          .n_waits == 1);
+}
+
+// 71  PCH  Punch
+TEST_CASE("punch a card")
+{
+    Card_Fixture f({punch_0000, punch_0100});
+    Buffer first;
+    Buffer second;
+    Address first_addr({0,0,2,7});
+    Address second_addr({0,1,2,7});
+    for (std::size_t i = 0; i < buffer_size; ++i, ++first_addr, ++second_addr)
+    {
+        auto digit = static_cast<TDigit>(i);
+        first.push_back(Word({0,0, 0,0,0,0, 0,0,1,digit, '+'}));
+        second.push_back(Word({0,0, 0,0,0,0, 0,0,2,digit, '-'}));
+        f.computer->set_drum(first_addr, first.back());
+        f.computer->set_drum(second_addr, second.back());
+    }
+    f.unit->load_punch_hopper(Card_Deck(4));
+    f.unit->punch_start();
+    CHECK(f.computer->run_for(100000) == Computer::Run_Status::stopped);
+    REQUIRE(f.unit->punch_stacker_deck().size() == 2);
+    CHECK(f.unit->punch_stacker_deck()[0] == buffer_to_card(first));
+    CHECK(f.unit->punch_stacker_deck()[1] == buffer_to_card(second));
+    // The second punch waits for the card cycle started by the first.
+    CHECK(f.computer->run_time() >= punch_cycle_word_times);
+}
@@ -0,0 +1,70 @@
+#include "pacer.hpp"
+#include "test_fixture.hpp"
+#include "doctest.h"
+
+#include <thread>
+
+using namespace IBM650;
+using namespace std::chrono;
+
+namespace
+{
+struct Pacer_Fixture : public Run_Fixture
+{
+    Pacer_Fixture() {
+        // A no-op at 0000 that goes to itself.
+        computer.set_drum(Address({0,0,0,0}), Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        computer.computer_reset();
+    }
+};
+}
+
+TEST_CASE("unlimited speed")
+{
+    Pacer_Fixture f;
+    Pacer pacer(f.computer, Pacer::unlimited, 1000);
+    CHECK(pacer.run_batch() == Computer::Run_Status::time_limit);
+    CHECK(f.computer.run_time() >= 1000);
+    CHECK(pacer.drift().n_batches == 0);
+}
+
+TEST_CASE("paced batches")
+{
+    Pacer_Fixture f;
+    // 1000 word times take 96 ms on the real machine, so 9.6 ms at 10 times speed.
+    Pacer pacer(f.computer, 10.0, 1000);
+    auto start = Pacer::Clock::now();
+    for (int i = 0; i < 5; ++i)
+        CHECK(pacer.run_batch() == Computer::Run_Status::time_limit);
+    auto elapsed = Pacer::Clock::now() - start;
+    auto emulated = duration<double, std::micro>(
+        f.computer.run_time()*microseconds_per_word_time/10.0);
+    CHECK(elapsed >= duration_cast<nanoseconds>(emulated));
+    CHECK(pacer.drift().n_batches + pacer.drift().n_resets == 5);
+    CHECK(pacer.drift().max >= pacer.drift().mean);
+
+    pacer.reset_drift();
+    CHECK(pacer.drift().n_batches == 0);
+}
+
+TEST_CASE("catch up")
+{
+    Pacer_Fixture f;
+    Pacer pacer(f.computer, 1.0);
+    // Nothing is due yet.
+    CHECK(pacer.catch_up() == Computer::Run_Status::time_limit);
+    std::this_thread::sleep_for(milliseconds(20));
+    CHECK(pacer.catch_up() == Computer::Run_Status::time_limit);
+    // About 208 word times in 20 ms.  Allow for a slow host, but not for a runaway.
+    CHECK(f.computer.run_time() > 150);
+    CHECK(f.computer.run_time() < 100*1000/96 + 100);
+}
+
+TEST_CASE("paced program stops")
+{
+    Pacer_Fixture f;
+    f.computer.set_drum(Address({0,0,0,0}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'}));
+    Pacer pacer(f.computer, 100.0);
+    CHECK(pacer.run_batch() == Computer::Run_Status::stopped);
+}
@@ -0,0 +1,94 @@
+#include "result_cache.hpp"
+#include "test_fixture.hpp"
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <future>
+
+using namespace IBM650;
+
+namespace
+{
+struct Cache_Fixture : public Temp_Path
+{
+    Cache_Fixture()
+        : Temp_Path("IBM650_test_result_cache")
+        {
+            job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,5, '+'});
+            job.drum = {{Address({0,0,0,5}), Word({6,5, 1,1,5,8, 0,0,1,3, '+'})},
+                        {Address({0,0,1,3}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'})},
+                        {Address({1,1,5,8}), Word({0,0, 0,1,1,2, 2,3,3,4, '-'})}};
+            job.word_time_limit = 1000;
+        }
+
+    Job job;
+};
+}
+
+TEST_CASE("result cache")
+{
+    Cache_Fixture f;
+    Result_Cache cache(f.path.string());
+    CHECK(!cache.find(f.job));
+
+    Computer_Pool pool;
+    auto result = run_job(pool.acquire(), f.job, f.job.word_time_limit);
+    cache.store(f.job, result);
+    auto found = cache.find(f.job);
+    REQUIRE(found);
+    CHECK(found->status == result.status);
+    CHECK(found->run_time == result.run_time);
+    CHECK(found->lower == result.lower);
+    CHECK(found->drum.size() == result.drum.size());
+
+    // Priority doesn't matter.
+    auto job = f.job;
+    job.priority = 10;
+    CHECK(cache.find(job));
+    // Anything that can change the result does.
+    job.word_time_limit = 2000;
+    CHECK(!cache.find(job));
+    job = f.job;
+    job.drum[2].second = Word({0,0, 0,1,1,2, 2,3,3,5, '-'});
+    CHECK(!cache.find(job));
+    job = f.job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,6, '+'});
+    CHECK(!cache.find(job));
+    job = f.job;
+    job.deck.push_back(IBM533::Card{});
+    CHECK(!cache.find(job));
+    // The versions are part of the key.
+    CHECK(Result_Cache::key(f.job).find("timing " + std::to_string(timing_model_version))
+          != std::string::npos);
+}
+
+TEST_CASE("damaged cache file")
+{
+    Cache_Fixture f;
+    Result_Cache cache(f.path.string());
+    Computer_Pool pool;
+    cache.store(f.job, run_job(pool.acquire(), f.job, f.job.word_time_limit));
+    for (const auto& entry : std::filesystem::directory_iterator(f.path))
+        std::ofstream(entry.path()) << Result_Cache::key(f.job) << "status\n";
+    CHECK(!cache.find(f.job));
+}
+
+TEST_CASE("job server uses the cache")
+{
+    Cache_Fixture f;
+    auto cache = std::make_shared<Result_Cache>(f.path.string());
+    // Give a different result than the job would get so we know it came from the cache.
+    Computer_Pool pool;
+    auto saved = run_job(pool.acquire(), f.job, f.job.word_time_limit);
+    saved.run_time = 12345;
+    cache->store(f.job, saved);
+
+    Job_Server server(1, f.job.word_time_limit, 0, cache);
+    std::promise<Job_Result> cached;
+    // A job without a limit gets the server's quota, which is the same.
+    auto job = f.job;
+    job.word_time_limit = 0;
+    server.submit(job, [&cached](const Job_Result& r) { cached.set_value(r); });
+    CHECK(cached.get_future().get().run_time == 12345);
+}
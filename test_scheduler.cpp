@@ -0,0 +1,103 @@
+#include "scheduler.hpp"
+#include "doctest.h"
+
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+enum class Event : std::uint8_t
+{
+    a,
+    b,
+    c,
+};
+
+std::vector<Event> pop_all(Scheduler<Event>& scheduler, TClock end_time)
+{
+    std::vector<Event> events;
+    Event event;
+    while (scheduler.pop(end_time, event))
+        events.push_back(event);
+    return events;
+}
+}
+
+TEST_CASE("schedule events")
+{
+    Scheduler<Event> scheduler;
+    CHECK(scheduler.empty());
+    scheduler.schedule(30, Event::a);
+    scheduler.schedule(10, Event::b);
+    scheduler.schedule(20, Event::c);
+    CHECK(scheduler.size() == 3);
+    CHECK(scheduler.next_time() == 10);
+
+    SUBCASE("pop in time order")
+    {
+        CHECK(pop_all(scheduler, 25) == std::vector<Event>{Event::b, Event::c});
+        CHECK(scheduler.now() == 25);
+        CHECK(pop_all(scheduler, 1000) == std::vector<Event>{Event::a});
+        CHECK(scheduler.now() == 1000);
+        CHECK(scheduler.empty());
+    }
+    SUBCASE("clock stops at each event")
+    {
+        Event event;
+        REQUIRE(scheduler.pop(1000, event));
+        CHECK(event == Event::b);
+        CHECK(scheduler.now() == 10);
+        // Delays are from the time of the event.
+        scheduler.schedule(5, Event::b);
+        CHECK(scheduler.next_time() == 15);
+    }
+    SUBCASE("ties in order of scheduling")
+    {
+        scheduler.schedule(10, Event::a);
+        scheduler.schedule(10, Event::c);
+        CHECK(pop_all(scheduler, 10) == std::vector<Event>{Event::b, Event::a, Event::c});
+    }
+    SUBCASE("cancel")
+    {
+        scheduler.schedule(40, Event::a);
+        scheduler.cancel(Event::a);
+        CHECK(!scheduler.is_pending(Event::a));
+        CHECK(scheduler.is_pending(Event::b));
+        CHECK(pop_all(scheduler, 1000) == std::vector<Event>{Event::b, Event::c});
+    }
+    SUBCASE("clear")
+    {
+        scheduler.clear();
+        CHECK(scheduler.empty());
+        CHECK(scheduler.now() == 0);
+    }
+    SUBCASE("the clock doesn't go back")
+    {
+        pop_all(scheduler, 100);
+        CHECK(pop_all(scheduler, 50).empty());
+        CHECK(scheduler.now() == 100);
+    }
+}
+
+TEST_CASE("save and restore scheduler")
+{
+    Scheduler<Event> scheduler;
+    scheduler.schedule(10, Event::a);
+    scheduler.schedule(10, Event::b);
+    scheduler.schedule(5, Event::c);
+    Event event;
+    scheduler.pop(7, event);
+
+    Snapshot::Writer writer;
+    scheduler.save(writer);
+    std::stringstream ss;
+    writer.write(ss, "TEST", 1);
+    Snapshot::Reader reader(ss, "TEST", 1);
+    Scheduler<Event> restored;
+    restored.load(reader);
+    reader.finish();
+
+    CHECK(restored.now() == 5);
+    CHECK(pop_all(restored, 100) == pop_all(scheduler, 100));
+}
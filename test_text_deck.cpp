@@ -0,0 +1,134 @@
+#include "text_deck.hpp"
+#include "test_fixture.hpp"
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace IBM533;
+using namespace IBM650;
+
+namespace
+{
+struct Text_Deck_Fixture : public Temp_Path
+{
+    Text_Deck_Fixture() : Temp_Path("IBM650_test_text_deck") {}
+};
+}
+
+TEST_CASE("text card characters")
+{
+    auto card = text_to_card("09AIJRSZ/+-{}#*");
+    CHECK(card[0] == 0x001);
+    CHECK(card[1] == 0x200);
+    CHECK(card[2] == (0x800 | 0x002));
+    CHECK(card[3] == (0x800 | 0x200));
+    CHECK(card[4] == (0x400 | 0x002));
+    CHECK(card[5] == (0x400 | 0x200));
+    CHECK(card[6] == (0x001 | 0x004));
+    CHECK(card[7] == (0x001 | 0x200));
+    CHECK(card[8] == (0x001 | 0x002));
+    CHECK(card[9] == 0x800);
+    CHECK(card[10] == 0x400);
+    CHECK(card[11] == (0x800 | 0x001));
+    CHECK(card[12] == (0x400 | 0x001));
+    CHECK(card[13] == (0x008 | 0x100));
+    CHECK(card[14] == (0x400 | 0x010 | 0x100));
+    CHECK(card[15] == 0);
+    CHECK(card[79] == 0);
+
+    const std::string all = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ/+-{}:#@'=\".<(|!$*);,%_>?";
+    CHECK(card_to_text(text_to_card(all)) == all);
+    // Lower case and & are read, but written as upper case and +.
+    CHECK(card_to_text(text_to_card("ab&  ")) == "AB+");
+    CHECK(card_to_text(Card{}) == "");
+
+    CHECK_THROWS(text_to_card("\t"));
+    CHECK_THROWS(text_to_card(std::string(81, '0')));
+    auto bad = Card{};
+    bad[5] = 0x006;
+    CHECK_THROWS(card_to_text(bad));
+}
+
+TEST_CASE("text card words")
+{
+    // The units digit is overpunched with the sign.
+    auto buffer = card_to_buffer(text_to_card("000000001A000000001J000000000{000000000}"));
+    CHECK(buffer[0] == Word({0,0, 0,0,0,0, 0,0,1,1, '+'}));
+    CHECK(buffer[1] == Word({0,0, 0,0,0,0, 0,0,1,1, '-'}));
+    CHECK(buffer[2] == Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+    CHECK(buffer[3] == Word({0,0, 0,0,0,0, 0,0,0,0, '-'}));
+
+    Buffer words(buffer_size, Word({1,2, 3,4,5,6, 7,8,9,0, '-'}));
+    CHECK(card_to_text(buffer_to_card(words)).substr(0, 20) == "123456789}123456789}");
+}
+
+TEST_CASE("read a text deck")
+{
+    Text_Deck_Fixture f;
+    std::ofstream(f.path, std::ios::binary)
+        << "0000000001\r\n"
+        << "\n"
+        << "00\t\n"
+        << std::string(81, '1') << '\n'
+        << "ABC";
+
+    SUBCASE("report bad cards")
+    {
+        std::vector<Text_Deck_Error> errors;
+        auto reader = text_deck_reader(f.path,
+                                       [&errors](const auto& e) { errors.push_back(e); });
+        Card card;
+        REQUIRE(reader(card));
+        CHECK(card == text_to_card("0000000001"));
+        REQUIRE(reader(card));
+        CHECK(card == Card{});
+        REQUIRE(reader(card));
+        CHECK(card == text_to_card("ABC"));
+        CHECK(!reader(card));
+
+        REQUIRE(errors.size() == 2);
+        CHECK(errors[0].line == 3);
+        CHECK(errors[0].column == 3);
+        CHECK(errors[1].line == 4);
+        CHECK(errors[1].column == 0);
+    }
+    SUBCASE("throw for bad cards")
+    {
+        auto reader = text_deck_reader(f.path);
+        Card card;
+        CHECK(reader(card));
+        CHECK(reader(card));
+        auto message = f.path.string() + ":3: bad character code 9 in column 3";
+        CHECK_THROWS_WITH(reader(card), message.c_str());
+    }
+}
+
+TEST_CASE("write a text deck")
+{
+    Text_Deck_Fixture f;
+    std::ofstream(f.path);
+    CHECK(!text_deck_reader(f.path)(*std::make_unique<Card>()));
+
+    Card_Deck deck{text_to_card("1234567890"), Card{}, text_to_card("  A")};
+    {
+        auto writer = text_deck_writer(f.path);
+        for (const auto& card : deck)
+            writer(card);
+    }
+    {
+        auto writer = text_deck_writer(f.path);
+        writer(text_to_card("Z"));
+    }
+    deck.push_back(text_to_card("Z"));
+
+    auto reader = text_deck_reader(f.path);
+    Card card;
+    for (const auto& expected : deck)
+    {
+        REQUIRE(reader(card));
+        CHECK(card == expected);
+    }
+    CHECK(!reader(card));
+    CHECK_THROWS(text_deck_reader(f.path.string() + "_missing"));
+}
@@ -0,0 +1,117 @@
+#include "time_travel.hpp"
+#include "doctest.h"
+
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+// Store lower in 0200 once, then add 1 to lower and store it in 0100 forever.
+Job counter_job()
+{
+    Job job;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,4, '+'});
+    job.drum = {{Address({0,0,0,4}), Word({2,0, 0,2,0,0, 0,0,0,5, '+'})},
+                {Address({0,0,0,5}), Word({1,5, 1,0,0,0, 0,0,0,6, '+'})},
+                {Address({0,0,0,6}), Word({2,0, 0,1,0,0, 0,0,0,5, '+'})},
+                {Address({1,0,0,0}), Word({0,0, 0,0,0,0, 0,0,0,1, '+'})}};
+    return job;
+}
+
+struct Time_Travel_Fixture
+{
+    Time_Travel_Fixture()
+        : computer(pool.acquire()),
+          unit(std::make_shared<IBM533::Input_Output_Unit>())
+        {
+            start_job(computer, unit, counter_job());
+        }
+
+    /// @Return a snapshot of the computer.
+    std::string state() const {
+        std::ostringstream os;
+        computer->save_state(os);
+        return os.str();
+    }
+
+    Computer_Pool pool;
+    std::shared_ptr<Computer> computer;
+    std::shared_ptr<IBM533::Input_Output_Unit> unit;
+};
+}
+
+TEST_CASE("step back")
+{
+    Time_Travel_Fixture f;
+    Time_Travel travel(*f.computer, 100, 4);
+    CHECK(!travel.step_back());
+    travel.run(5000);
+    CHECK(travel.n_checkpoints() > 4);
+    auto position = travel.position();
+    auto before = f.state();
+    travel.step();
+    travel.step();
+    auto after = f.state();
+
+    REQUIRE(travel.step_back());
+    REQUIRE(travel.step_back());
+    CHECK(travel.position() == position);
+    CHECK(f.state() == before);
+
+    // Forward again to the same state.
+    travel.step();
+    travel.step();
+    CHECK(f.state() == after);
+}
+
+TEST_CASE("back to last write")
+{
+    Time_Travel_Fixture f;
+    Time_Travel travel(*f.computer, 100, 4);
+    travel.run(5000);
+    auto position = travel.position();
+
+    // 0100 is written every other instruction.
+    REQUIRE(travel.back_to_last_write(Address({0,1,0,0})));
+    CHECK(travel.position() >= position - 2);
+    auto count = f.computer->get_drum(Address({0,1,0,0}));
+    travel.step();
+    CHECK(f.computer->get_drum(Address({0,1,0,0})) != count);
+
+    // 0200 is only written by the first instruction after the one in the storage-entry
+    // switches.
+    REQUIRE(travel.back_to_last_write(Address({0,2,0,0})));
+    CHECK(travel.position() == 1);
+
+    // 1999 is never written.
+    travel.go_to(3000);
+    position = travel.position();
+    CHECK(!travel.back_to_last_write(Address({1,9,9,9})));
+    CHECK(travel.position() == position);
+}
+
+TEST_CASE("go to word time")
+{
+    Time_Travel_Fixture f;
+    Time_Travel travel(*f.computer, 100, 4);
+    travel.run(5000);
+    auto end = f.computer->run_time();
+
+    REQUIRE(travel.go_to(2500));
+    CHECK(f.computer->run_time() <= 2500);
+    auto position = travel.position();
+    auto state = f.state();
+    travel.step();
+    CHECK(f.computer->run_time() > 2500);
+
+    // Going forward past the end runs the job.
+    REQUIRE(travel.go_to(end + 1000));
+    CHECK(f.computer->run_time() <= end + 1000);
+    CHECK(travel.position() > position);
+
+    REQUIRE(travel.go_to(2500));
+    CHECK(f.state() == state);
+    REQUIRE(travel.go_to(0));
+    CHECK(travel.position() == 0);
+}
@@ -0,0 +1,187 @@
+#include "text_deck.hpp"
+#include "mapped_file.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace IBM533;
+
+namespace
+{
+constexpr int row_12 = 0x800;
+constexpr int row_11 = 0x400;
+constexpr int row_8 = 1 << 8;
+constexpr int all_rows = 0xfff;
+
+/// @Return the punch for a digit row.
+constexpr int row(int digit)
+{
+    return 1 << digit;
+}
+
+struct Character
+{
+    char c;
+    int punches;
+};
+
+/// The characters other than digits and letters.  Where more than one character has the same
+/// punches, the first is written.
+constexpr Character specials[] = {
+    {' ', 0}, {'+', row_12}, {'&', row_12}, {'-', row_11}, {'/', row(0) | row(1)},
+    {'{', row_12 | row(0)}, {'}', row_11 | row(0)},
+    {':', row(2) | row_8}, {'#', row(3) | row_8}, {'@', row(4) | row_8},
+    {'\'', row(5) | row_8}, {'=', row(6) | row_8}, {'"', row(7) | row_8},
+    {'.', row_12 | row(3) | row_8}, {'<', row_12 | row(4) | row_8},
+    {'(', row_12 | row(5) | row_8}, {'|', row_12 | row(7) | row_8},
+    {'!', row_11 | row(2) | row_8}, {'$', row_11 | row(3) | row_8},
+    {'*', row_11 | row(4) | row_8}, {')', row_11 | row(5) | row_8},
+    {';', row_11 | row(6) | row_8},
+    {',', row(0) | row(3) | row_8}, {'%', row(0) | row(4) | row_8},
+    {'_', row(0) | row(5) | row_8}, {'>', row(0) | row(6) | row_8},
+    {'?', row(0) | row(7) | row_8}};
+
+/// @Return a table of the punches for each character, or -1 if it has none.
+constexpr std::array<int, 256> make_char_punches()
+{
+    std::array<int, 256> punches{};
+    for (auto& p : punches)
+        p = -1;
+    for (int d = 0; d <= 9; ++d)
+        punches['0' + d] = row(d);
+    for (int d = 1; d <= 9; ++d)
+    {
+        punches['A' + d - 1] = punches['a' + d - 1] = row_12 | row(d);
+        punches['J' + d - 1] = punches['j' + d - 1] = row_11 | row(d);
+    }
+    for (int d = 2; d <= 9; ++d)
+        punches['S' + d - 2] = punches['s' + d - 2] = row(0) | row(d);
+    for (const auto& special : specials)
+        punches[static_cast<unsigned char>(special.c)] = special.punches;
+    return punches;
+}
+
+/// @Return a table of the character for each pattern of punches, or 0 if there's none.
+constexpr std::array<char, all_rows + 1> make_punch_chars()
+{
+    std::array<char, all_rows + 1> chars{};
+    for (int d = 0; d <= 9; ++d)
+        chars[row(d)] = '0' + d;
+    for (int d = 1; d <= 9; ++d)
+    {
+        chars[row_12 | row(d)] = 'A' + d - 1;
+        chars[row_11 | row(d)] = 'J' + d - 1;
+    }
+    for (int d = 2; d <= 9; ++d)
+        chars[row(0) | row(d)] = 'S' + d - 2;
+    for (const auto& special : specials)
+        if (chars[special.punches] == 0)
+            chars[special.punches] = special.c;
+    return chars;
+}
+
+constexpr auto char_punches = make_char_punches();
+constexpr auto punch_chars = make_punch_chars();
+
+/// Set the card to the punches for the characters from begin to end.  @Return false and set
+/// the column and message of the error if the line can't be punched.
+bool to_card(const char* begin, const char* end, Card& card, Text_Deck_Error& error)
+{
+    if (end - begin > static_cast<std::ptrdiff_t>(card_columns))
+    {
+        error.column = 0;
+        error.message = "line is longer than " + std::to_string(card_columns) + " columns";
+        return false;
+    }
+    std::size_t i = 0;
+    for (auto p = begin; p != end; ++p, ++i)
+    {
+        auto punches = char_punches[static_cast<unsigned char>(*p)];
+        if (punches < 0)
+        {
+            error.column = i + 1;
+            auto code = static_cast<unsigned char>(*p);
+            error.message = (std::isprint(code) ? std::string("bad character '") + *p + "'"
+                             : "bad character code " + std::to_string(code))
+                + " in column " + std::to_string(i + 1);
+            return false;
+        }
+        card[i] = punches;
+    }
+    std::fill(card.begin() + i, card.end(), 0);
+    return true;
+}
+}
+
+Card IBM533::text_to_card(const std::string& line)
+{
+    Card card;
+    Text_Deck_Error error;
+    if (!to_card(line.data(), line.data() + line.size(), card, error))
+        throw std::runtime_error(error.message);
+    return card;
+}
+
+std::string IBM533::card_to_text(const Card& card)
+{
+    std::string line(card_columns, ' ');
+    for (std::size_t i = 0; i < card_columns; ++i)
+    {
+        auto c = (card[i] & ~all_rows) == 0 ? punch_chars[card[i]] : 0;
+        if (c == 0)
+            throw std::runtime_error("no character for the punches in column "
+                                     + std::to_string(i + 1));
+        line[i] = c;
+    }
+    line.erase(line.find_last_not_of(' ') + 1);
+    return line;
+}
+
+Card_Reader IBM533::text_deck_reader(const std::string& path, Text_Deck_Error_Handler on_error)
+{
+    // Empty files can't be mapped.
+    if (std::filesystem::file_size(path) == 0)
+        return [](Card&) { return false; };
+
+    auto file = std::make_shared<Mapped_File>(path);
+    std::size_t offset = 0;
+    std::size_t line = 0;
+    return [file, offset, line, path, on_error](Card& card) mutable {
+        auto end_of_file = file->data() + file->size();
+        while (offset < file->size())
+        {
+            auto begin = file->data() + offset;
+            auto newline = static_cast<const char*>(std::memchr(begin, '\n', end_of_file - begin));
+            auto end = newline ? newline : end_of_file;
+            offset = (newline ? newline + 1 : end_of_file) - file->data();
+            ++line;
+            if (end != begin && end[-1] == '\r')
+                --end;
+
+            Text_Deck_Error error;
+            if (to_card(begin, end, card, error))
+                return true;
+            error.line = line;
+            if (!on_error)
+                throw std::runtime_error(path + ":" + std::to_string(line) + ": "
+                                         + error.message);
+            on_error(error);
+        }
+        return false;
+    };
+}
+
+Card_Writer IBM533::text_deck_writer(const std::string& path)
+{
+    auto os = std::make_shared<std::ofstream>(path, std::ios::app);
+    if (!*os)
+        throw std::runtime_error("can't open text deck " + path);
+    return [os, path](const Card& card) {
+        *os << card_to_text(card) << '\n';
+        if (!*os)
+            throw std::runtime_error("can't write text deck " + path);
+    };
+}
@@ -0,0 +1,55 @@
+#ifndef TEXT_DECK_HPP
+#define TEXT_DECK_HPP
+
+#include "input_output_unit.hpp"
+
+#include <functional>
+#include <string>
+
+namespace IBM533
+{
+/// Text decks are card images as used by other 650 emulators, such as SimH: one line per
+/// card, one character per column.  Short lines are padded with blank columns.  Lines end
+/// with LF or CR LF.
+///
+/// Characters map to Hollerith punches as on the IBM 029 keypunch.  A blank is no punch,
+/// digits are a single punch, A-I are 12 over 1-9, J-R are 11 over 1-9, and / and S-Z are 0
+/// over 1-9.  + and & are a lone 12 punch, - is a lone 11 punch, and { and } are 12 and 11
+/// over 0.  So a 650 word's sign shows as the units digit overpunched with 12 or 11: { and
+/// A-I for plus, } and J-R for minus.  The 029's special characters are also accepted, e.g.
+/// # for 3-8 and * for 11-4-8.
+
+/// A bad card in a text deck.
+struct Text_Deck_Error
+{
+    /// The line number, counting from 1.
+    std::size_t line;
+    /// The column of the bad character, counting from 1, or 0 if the line is too long.
+    std::size_t column;
+    std::string message;
+};
+/// A function that's passed bad cards.
+using Text_Deck_Error_Handler = std::function<void(const Text_Deck_Error&)>;
+
+/// @Return the punches for a line of a text deck.  Throws std::runtime_error if the line is
+/// too long or has a character that has no punches.
+Card text_to_card(const std::string& line);
+/// @Return the line for a card with trailing blanks removed.  Throws std::runtime_error if
+/// a column's punches have no character.
+std::string card_to_text(const Card& card);
+
+/// @Return a reader that pulls cards from a text deck file in order.  The file is mapped
+/// read-only and converted as cards are pulled, so any size of file streams at about the
+/// speed of the disk.  Bad cards are passed to the error handler and skipped.  With no
+/// handler, the reader throws std::runtime_error for a bad card, giving its line number.
+/// Throws std::runtime_error if the file can't be read.
+Card_Reader text_deck_reader(const std::string& path,
+                             Text_Deck_Error_Handler on_error = nullptr);
+/// @Return a writer that appends cards to a text deck file, e.g. for a spilling stacker.
+/// The file is created if it doesn't exist.  Lines are buffered, and are all in the file
+/// when the last copy of the writer is destroyed.  The writer throws std::runtime_error if a
+/// card has a column with no character or if the file can't be written.
+Card_Writer text_deck_writer(const std::string& path);
+}
+
+#endif
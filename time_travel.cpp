@@ -0,0 +1,177 @@
+#include "time_travel.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+Address to_address(std::size_t n)
+{
+    return Address({TDigit(n/1000), TDigit(n/100%10), TDigit(n/10%10), TDigit(n%10)});
+}
+}
+
+Time_Travel::Time_Travel(Computer& computer, TTime interval, std::size_t key_interval)
+    : m_computer(computer),
+      m_interval(interval),
+      m_key_interval(std::max<std::size_t>(key_interval, 1))
+{
+    checkpoint();
+}
+
+bool Time_Travel::step()
+{
+    if (m_stop_position && m_position == *m_stop_position)
+        return false;
+    Job_Result::Status status;
+    bool stopped = step_job(m_computer, status);
+    ++m_position;
+    if (stopped)
+    {
+        m_stop_position = m_position;
+        m_status = status;
+    }
+    const auto& last = m_checkpoints.back();
+    if (m_position > last.position && m_computer.run_time() - last.run_time >= m_interval)
+        checkpoint();
+    return !stopped;
+}
+
+bool Time_Travel::run(TTime word_time_limit)
+{
+    while (m_computer.run_time() < word_time_limit)
+        if (!step())
+            return true;
+    return false;
+}
+
+bool Time_Travel::step_back()
+{
+    if (m_position == 0)
+        return false;
+    restore(m_position - 1);
+    return true;
+}
+
+bool Time_Travel::back_to_last_write(const Address& address)
+{
+    auto end = m_position;
+    auto word_number = address.value();
+    // Search back a segment between checkpoints at a time.  Only segments that may have
+    // written the word are run.
+    for (auto k = checkpoint_before(end) + 1; k-- > 0;)
+    {
+        auto segment_end = end;
+        if (k + 1 < m_checkpoints.size() && m_checkpoints[k + 1].position <= end)
+        {
+            if (!m_checkpoints[k + 1].written[word_number])
+                continue;
+            segment_end = m_checkpoints[k + 1].position;
+        }
+        restore(m_checkpoints[k].position);
+        std::optional<std::size_t> last_write;
+        while (m_position < segment_end)
+        {
+            m_computer.forget_changes();
+            replay();
+            if (m_computer.drum_changed(address))
+                last_write = m_position - 1;
+        }
+        if (last_write)
+        {
+            restore(*last_write);
+            return true;
+        }
+    }
+    restore(end);
+    return false;
+}
+
+bool Time_Travel::go_to(TTime time)
+{
+    if (time < m_checkpoints.front().run_time)
+        return false;
+    auto k = m_checkpoints.size();
+    while (m_checkpoints[--k].run_time > time)
+        ;
+    // Find the last instruction that starts by the passed-in time, then go back to it.
+    restore(m_checkpoints[k].position);
+    auto target = m_position;
+    while (step() && m_computer.run_time() <= time)
+        target = m_position;
+    if (m_position != target && m_computer.run_time() <= time)
+        target = m_position;
+    if (m_position != target)
+        restore(target);
+    return true;
+}
+
+std::size_t Time_Travel::position() const
+{
+    return m_position;
+}
+
+std::optional<Job_Result::Status> Time_Travel::status() const
+{
+    if (m_stop_position && m_position == *m_stop_position)
+        return m_status;
+    return std::nullopt;
+}
+
+std::size_t Time_Travel::n_checkpoints() const
+{
+    return m_checkpoints.size();
+}
+
+void Time_Travel::checkpoint()
+{
+    Checkpoint checkpoint;
+    checkpoint.position = m_position;
+    checkpoint.run_time = m_computer.run_time();
+    for (std::size_t n = 0; n < n_words; ++n)
+        checkpoint.written[n] = m_computer.drum_changed(to_address(n));
+    checkpoint.full = m_checkpoints.size() % m_key_interval == 0;
+    std::ostringstream os;
+    if (checkpoint.full)
+    {
+        m_computer.save_state(os);
+        m_computer.forget_changes();
+    }
+    else
+        m_computer.save_changes(os);
+    checkpoint.snapshot = os.str();
+    m_checkpoints.push_back(std::move(checkpoint));
+}
+
+void Time_Travel::restore(std::size_t position)
+{
+    auto k = checkpoint_before(position);
+    auto key = k - k % m_key_interval;
+    std::istringstream key_snapshot(m_checkpoints[key].snapshot);
+    m_computer.load_state(key_snapshot);
+    for (auto i = key + 1; i <= k; ++i)
+    {
+        std::istringstream changes(m_checkpoints[i].snapshot);
+        m_computer.load_changes(changes);
+    }
+    m_position = m_checkpoints[k].position;
+    while (m_position < position)
+        replay();
+}
+
+std::size_t Time_Travel::checkpoint_before(std::size_t position) const
+{
+    auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), position,
+                               [](std::size_t pos, const Checkpoint& checkpoint) {
+                                   return pos < checkpoint.position; });
+    return it - m_checkpoints.begin() - 1;
+}
+
+void Time_Travel::replay()
+{
+    Job_Result::Status status;
+    step_job(m_computer, status);
+    ++m_position;
+}
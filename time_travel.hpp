@@ -0,0 +1,88 @@
+#ifndef TIME_TRAVEL_HPP
+#define TIME_TRAVEL_HPP
+
+#include "computer.hpp"
+#include "job.hpp"
+
+#include <bitset>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace IBM650
+{
+/// Debugging support for running a job backwards.  Checkpoints are taken as the job runs
+/// forward.  Going back restores the nearest checkpoint and runs the job forward again to
+/// the wanted instruction.  Since the emulator is deterministic, the job goes through the
+/// same states again.  Checkpoints are incremental, with a full one every key_interval, so
+/// going back costs at most key_interval restores and interval word times of running, no
+/// matter how long the job has run.
+///
+/// The computer must be started with start_job().  Don't change it except through this
+/// class while recording, or the history will be wrong.
+class Time_Travel
+{
+public:
+    /// Start recording the computer from its current state.  Take a checkpoint after each
+    /// instruction that ends at least interval word times after the last one.
+    Time_Travel(Computer& computer, TTime interval = 10000, std::size_t key_interval = 16);
+
+    /// Run one instruction.  @Return false if the job had already stopped or stops now.
+    bool step();
+    /// Run until the job stops or its run time reaches word_time_limit.  @Return true if the
+    /// job stopped.
+    bool run(TTime word_time_limit);
+    /// Go back to the start of the previous instruction.  @Return false if recording started
+    /// here.
+    bool step_back();
+    /// Go back to the start of the last instruction that wrote to the passed-in drum address.
+    /// @Return false, and stay here, if it wasn't written since recording started.
+    bool back_to_last_write(const Address& address);
+    /// Go to the start of the instruction that was running at the passed-in word time.  Runs
+    /// forward if the job hasn't got there yet.  @Return false, and stay here, if the time
+    /// is before recording started.
+    bool go_to(TTime time);
+
+    /// @Return the number of instructions run since recording started.
+    std::size_t position() const;
+    /// @Return the reason the job stopped, if it has.
+    std::optional<Job_Result::Status> status() const;
+    /// @Return the number of checkpoints taken.
+    std::size_t n_checkpoints() const;
+
+private:
+    static constexpr std::size_t n_words = n_bands*band_size;
+
+    struct Checkpoint
+    {
+        /// The number of instructions run since recording started.
+        std::size_t position;
+        TTime run_time;
+        /// A full snapshot, or the changes since the checkpoint before.
+        bool full;
+        std::string snapshot;
+        /// Words that may have been written since the checkpoint before, by word number.
+        std::bitset<n_words> written;
+    };
+
+    void checkpoint();
+    /// Restore the last checkpoint at or before the passed-in position and run forward to
+    /// it.
+    void restore(std::size_t position);
+    /// @Return the index of the last checkpoint at or before the passed-in position.
+    std::size_t checkpoint_before(std::size_t position) const;
+    /// Run an instruction that has already been recorded.
+    void replay();
+
+    Computer& m_computer;
+    TTime m_interval;
+    std::size_t m_key_interval;
+    std::vector<Checkpoint> m_checkpoints;
+    std::size_t m_position = 0;
+    /// The position after the instruction that stopped the job, and the reason.
+    std::optional<std::size_t> m_stop_position;
+    Job_Result::Status m_status = Job_Result::Status::stopped;
+};
+}
+
+#endif